@@ -0,0 +1,136 @@
+/*
+  Disseminate, keyboard broadcaster
+  Copyright (C) 2016  Jan Erik Hanssen
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ClientLauncher.h"
+#include <QProcess>
+#include <algorithm>
+
+ClientLauncher::ClientLauncher(QObject* parent)
+    : QObject(parent), stage(Idle), total(0), deadline(0), stageEnd(0)
+{
+    escalation.setSingleShot(true);
+    connect(&escalation, &QTimer::timeout, this, &ClientLauncher::escalate);
+}
+
+ClientLauncher::~ClientLauncher()
+{
+    if (!processes.isEmpty()) {
+        if (stage == Idle)
+            shutdown();
+        waitForShutdown();
+    }
+}
+
+void ClientLauncher::launch(const QString& program, const QProcessEnvironment& env, const QStringList& clients)
+{
+    for (const QString& client : clients) {
+        if (processes.contains(client))
+            continue;
+        QProcess* proc = new QProcess(this);
+        QProcessEnvironment procEnv = env;
+        procEnv.insert("DISSEMINATE_CLIENT", client);
+        proc->setProcessEnvironment(procEnv);
+        connect(proc, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+                this, [this, client]() { finished(client); });
+        connect(proc, &QProcess::errorOccurred, this, [this, proc, client](QProcess::ProcessError error) {
+                emit failed(client, proc->errorString());
+                // a process that never started won't finish either
+                if (error == QProcess::FailedToStart)
+                    finished(client);
+            });
+        processes[client] = proc;
+        // start() only forks, it doesn't wait for the app to come up
+        proc->start(program);
+    }
+}
+
+void ClientLauncher::shutdown(int grace, int dl)
+{
+    if (stage != Idle)
+        return;
+    if (processes.isEmpty()) {
+        emit stopped();
+        return;
+    }
+    stage = Terminating;
+    total = processes.size();
+    deadline = std::max(dl, grace);
+    stageEnd = grace;
+    clock.start();
+
+    for (const QString& client : processes.keys()) {
+        if (terminateRequest)
+            terminateRequest(client);
+    }
+    emit progress(0, total);
+    escalation.start(grace);
+}
+
+void ClientLauncher::escalate()
+{
+    switch (stage) {
+    case Terminating:
+        for (QProcess* proc : processes)
+            proc->terminate();
+        stage = Signalled;
+        stageEnd = deadline;
+        escalation.start(std::max<qint64>(stageEnd - clock.elapsed(), 0));
+        break;
+    case Signalled:
+        for (QProcess* proc : processes)
+            proc->kill();
+        stage = Killed;
+        break;
+    default:
+        break;
+    }
+}
+
+void ClientLauncher::finished(const QString& client)
+{
+    QProcess* proc = processes.take(client);
+    if (!proc)
+        return;
+    proc->deleteLater();
+    if (stage == Idle)
+        return;
+    emit progress(total - processes.size(), total);
+    if (processes.isEmpty()) {
+        escalation.stop();
+        stage = Idle;
+        emit stopped();
+    }
+}
+
+void ClientLauncher::waitForShutdown()
+{
+    // waitForFinished emits finished() before returning, which takes the
+    // process out of the map
+    while (!processes.isEmpty() && stage != Idle) {
+        QProcess* proc = processes.first();
+        if (stage == Killed) {
+            if (!proc->waitForFinished(1000)) {
+                qWarning("client %s did not exit after SIGKILL", qPrintable(processes.firstKey()));
+                finished(processes.firstKey());
+            }
+            continue;
+        }
+        if (!proc->waitForFinished(std::max<qint64>(stageEnd - clock.elapsed(), 0)))
+            escalate();
+    }
+}
@@ -0,0 +1,81 @@
+/*
+  Disseminate, keyboard broadcaster
+  Copyright (C) 2016  Jan Erik Hanssen
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLIENTLAUNCHER_H
+#define CLIENTLAUNCHER_H
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QObject>
+#include <QProcessEnvironment>
+#include <QStringList>
+#include <QTimer>
+#include <functional>
+
+class QProcess;
+
+// Starts and stops a set of client processes without blocking. launch()
+// starts every client at once, shutdown() asks them all to quit and then
+// escalates for the ones still running: SIGTERM once the grace period is
+// up, SIGKILL at the deadline. Progress comes back through signals.
+class ClientLauncher : public QObject
+{
+    Q_OBJECT
+
+public:
+    ClientLauncher(QObject* parent = 0);
+    ~ClientLauncher();
+
+    // called for every client at the start of a shutdown, should ask the
+    // client to quit without waiting for it
+    typedef std::function<void(const QString& client)> TerminateRequest;
+    void onTerminate(const TerminateRequest& on) { terminateRequest = on; }
+
+    void launch(const QString& program, const QProcessEnvironment& env, const QStringList& clients);
+    // grace and deadline are in ms from the start of the shutdown
+    void shutdown(int grace = 2000, int deadline = 5000);
+    // runs whatever is left of a shutdown synchronously, for when there's
+    // no event loop to deliver the signals anymore
+    void waitForShutdown();
+
+    bool isEmpty() const { return processes.isEmpty(); }
+    bool isShuttingDown() const { return stage != Idle; }
+
+signals:
+    void failed(const QString& client, const QString& error);
+    void progress(int stopped, int total);
+    void stopped();
+
+private slots:
+    void escalate();
+
+private:
+    void finished(const QString& client);
+
+    enum Stage { Idle, Terminating, Signalled, Killed };
+
+    QMap<QString, QProcess*> processes;
+    TerminateRequest terminateRequest;
+    QTimer escalation;
+    QElapsedTimer clock;
+    Stage stage;
+    int total, deadline;
+    qint64 stageEnd;
+};
+
+#endif
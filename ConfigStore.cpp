@@ -0,0 +1,469 @@
+/*
+  Disseminate, keyboard broadcaster
+  Copyright (C) 2016  Jan Erik Hanssen
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ConfigStore.h"
+#include "IconCache.h"
+#include "FlatbufferEncoder.h"
+#include <Settings_generated.h>
+#include <Config_generated.h>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QSettings>
+#include <QStandardPaths>
+#include <vector>
+
+namespace {
+
+const char* const KeysFile = "keys.fb";
+const char* const TemplatesFile = "templates.fb";
+const char* const PreferencesFile = "preferences.fb";
+const char* const ConfigurationsFile = "configurations.fb";
+const char* const IconDir = "icons";
+
+// maps a section for as long as it's being parsed, nothing read from it
+// may outlive this
+class MappedSection
+{
+public:
+    MappedSection(const QString& path)
+        : file(path), data(0)
+    {
+        if (file.open(QIODevice::ReadOnly) && file.size() > 0)
+            data = file.map(0, file.size());
+    }
+    ~MappedSection()
+    {
+        if (data)
+            file.unmap(data);
+    }
+
+    template<typename T>
+    const T* root()
+    {
+        if (!data)
+            return 0;
+        flatbuffers::Verifier verifier(data, file.size());
+        if (!verifier.VerifyBuffer<T>(nullptr)) {
+            qWarning("ConfigStore: %s is corrupt, ignoring it", qPrintable(file.fileName()));
+            return 0;
+        }
+        return flatbuffers::GetRoot<T>(data);
+    }
+
+private:
+    QFile file;
+    uchar* data;
+};
+
+inline QString toQString(const flatbuffers::String* str)
+{
+    return str ? QString::fromUtf8(str->c_str(), str->size()) : QString();
+}
+
+inline flatbuffers::Offset<flatbuffers::String> fromQString(flatbuffers::FlatBufferBuilder& builder, const QString& str)
+{
+    const QByteArray utf8 = str.toUtf8();
+    return builder.CreateString(utf8.constData(), utf8.size());
+}
+
+inline KeyCode toKeyCode(const Disseminate::Settings::Key& key)
+{
+    return KeyCode(key.keyCode(), key.modifiers());
+}
+
+void readKeys(const flatbuffers::Vector<const Disseminate::Settings::Key*>* from, QVector<KeyCode>& to)
+{
+    to.clear();
+    if (!from)
+        return;
+    to.reserve(from->size());
+    for (const Disseminate::Settings::Key* key : *from)
+        to.append(toKeyCode(*key));
+}
+
+flatbuffers::Offset<flatbuffers::Vector<const Disseminate::Settings::Key*> >
+writeKeyVector(flatbuffers::FlatBufferBuilder& builder, const QVector<KeyCode>& keys)
+{
+    std::vector<Disseminate::Settings::Key> out;
+    out.reserve(keys.size());
+    for (const KeyCode& key : keys)
+        out.emplace_back(key.first, key.second);
+    return builder.CreateVectorOfStructs(out);
+}
+
+// the QSettings layout is a list of { key, mask } maps
+KeyCode readSettingsKey(const QVariantMap& km, bool* ok)
+{
+    *ok = km.contains("key") && km.contains("mask");
+    return KeyCode(km["key"].toLongLong(), km["mask"].toULongLong());
+}
+
+QVector<KeyCode> readSettingsKeys(const QList<QVariant>& list)
+{
+    QVector<KeyCode> keys;
+    for (const auto& elem : list) {
+        bool ok;
+        const KeyCode key = readSettingsKey(elem.toMap(), &ok);
+        if (ok)
+            keys.append(key);
+    }
+    return keys;
+}
+
+} // anonymous namespace
+
+ConfigStore::ConfigStore(const QString& path, QObject* parent)
+    : QObject(parent), dir(path), dirty(0), delay(250), maxDelay(2000)
+{
+    timer.setSingleShot(true);
+    connect(&timer, &QTimer::timeout, this, &ConfigStore::flush);
+}
+
+ConfigStore::~ConfigStore()
+{
+    flush();
+}
+
+QString ConfigStore::defaultPath()
+{
+    // next to where QSettings("jhanssen", "Disseminate") used to keep it
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/jhanssen/Disseminate";
+}
+
+bool ConfigStore::isEmpty() const
+{
+    const QDir d(dir);
+    return !d.exists(KeysFile) && !d.exists(TemplatesFile)
+        && !d.exists(PreferencesFile) && !d.exists(ConfigurationsFile);
+}
+
+void ConfigStore::setDelay(int d, int max)
+{
+    delay = d;
+    maxDelay = max;
+}
+
+bool ConfigStore::load(KeyList& out) const
+{
+    MappedSection section(dir + '/' + KeysFile);
+    const Disseminate::Config::Keys* root = section.root<Disseminate::Config::Keys>();
+    if (!root)
+        return false;
+    out.whitelist = root->type() != Disseminate::Settings::Type_BlackList;
+    readKeys(root->keys(), out.keys);
+    return true;
+}
+
+bool ConfigStore::load(Templates::Config& out) const
+{
+    MappedSection section(dir + '/' + TemplatesFile);
+    const Disseminate::Config::Templates* root = section.root<Disseminate::Config::Templates>();
+    if (!root)
+        return false;
+    out.clear();
+    if (const auto templs = root->templates()) {
+        for (const Disseminate::Config::Template* templ : *templs) {
+            Templates::ConfigItem item;
+            item.whitelist = templ->whitelist();
+            readKeys(templ->keys(), item.keys);
+            if (const auto remaps = templ->remaps()) {
+                for (const Disseminate::Settings::Remap* remap : *remaps)
+                    item.remaps.append(KeyRemap(toKeyCode(remap->from()), toKeyCode(remap->to())));
+            }
+            out[toQString(templ->name())] = item;
+        }
+    }
+    return true;
+}
+
+bool ConfigStore::load(Preferences::Config& out) const
+{
+    MappedSection section(dir + '/' + PreferencesFile);
+    const Disseminate::Config::Preferences* root = section.root<Disseminate::Config::Preferences>();
+    if (!root)
+        return false;
+    out.globalKey = root->toggleKeyboard() ? toKeyCode(*root->toggleKeyboard()) : KeyCode(0, 0);
+    out.globalMouse = root->toggleMouse() ? toKeyCode(*root->toggleMouse()) : KeyCode(0, 0);
+    readKeys(root->exclusions(), out.exclusions);
+    out.automaticWindows.clear();
+    if (const auto windows = root->automaticWindows()) {
+        for (const flatbuffers::String* window : *windows)
+            out.automaticWindows.append(toQString(window));
+    }
+    return true;
+}
+
+bool ConfigStore::load(QVector<Configuration::Item>& out) const
+{
+    MappedSection section(dir + '/' + ConfigurationsFile);
+    const Disseminate::Config::Configurations* root = section.root<Disseminate::Config::Configurations>();
+    if (!root)
+        return false;
+    out.clear();
+    if (const auto apps = root->configurations()) {
+        for (const Disseminate::Config::Application* app : *apps) {
+            Configuration::Item item;
+            item.name = toQString(app->name());
+            item.appPath = toQString(app->appPath());
+            // the cached icon is shared with everything else showing this app,
+            // the stored one is only a fallback for apps that went missing
+            item.appIcon = IconCache::instance()->forPath(item.appPath);
+            if (item.appIcon.isNull() && app->icon())
+                item.appIcon = QPixmap(dir + '/' + IconDir + '/' + toQString(app->icon()));
+            if (const auto clients = app->clients()) {
+                const auto groups = app->groups();
+                for (flatbuffers::uoffset_t i = 0; i < clients->size(); ++i) {
+                    const QString client = toQString(clients->Get(i));
+                    item.clients.append(client);
+                    const QString group = groups && i < groups->size() ? toQString(groups->Get(i)) : QString();
+                    if (!group.isEmpty())
+                        item.groups[client] = group;
+                }
+            }
+            out.append(item);
+        }
+    }
+    return true;
+}
+
+void ConfigStore::save(const KeyList& k)
+{
+    keys = k;
+    markDirty(KeysSection);
+}
+
+void ConfigStore::save(const Templates::Config& t)
+{
+    templates = t;
+    markDirty(TemplatesSection);
+}
+
+void ConfigStore::save(const Preferences::Config& p)
+{
+    preferences = p;
+    markDirty(PreferencesSection);
+}
+
+void ConfigStore::save(const QVector<Configuration::Item>& c)
+{
+    configurations = c;
+    markDirty(ConfigurationsSection);
+}
+
+void ConfigStore::markDirty(Section section)
+{
+    dirty |= section;
+    if (!timer.isActive())
+        pending.start();
+    // keep pushing the write back while changes come in, up to maxDelay
+    if (pending.elapsed() < maxDelay)
+        timer.start(delay);
+}
+
+void ConfigStore::flush()
+{
+    timer.stop();
+    if (!dirty)
+        return;
+    QDir().mkpath(dir);
+    if (dirty & KeysSection)
+        writeKeys();
+    if (dirty & TemplatesSection)
+        writeTemplates();
+    if (dirty & PreferencesSection)
+        writePreferences();
+    if (dirty & ConfigurationsSection)
+        writeConfigurations();
+    dirty = 0;
+}
+
+bool ConfigStore::write(const QString& name, flatbuffers::FlatBufferBuilder& builder) const
+{
+    // QSaveFile writes to a temporary and renames it over the old file on
+    // commit, a reader never sees half a section
+    QSaveFile file(dir + '/' + name);
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(reinterpret_cast<const char*>(builder.GetBufferPointer()), builder.GetSize()) != static_cast<qint64>(builder.GetSize())
+        || !file.commit()) {
+        qWarning("ConfigStore: unable to write %s: %s", qPrintable(file.fileName()), qPrintable(file.errorString()));
+        return false;
+    }
+    return true;
+}
+
+void ConfigStore::writeKeys() const
+{
+    FlatbufferEncoder encoder;
+    auto& builder = encoder.builder();
+    const auto keyVector = writeKeyVector(builder, keys.keys);
+    encoder.finish(Disseminate::Config::CreateKeys(builder,
+                                                   keys.whitelist ? Disseminate::Settings::Type_WhiteList
+                                                                  : Disseminate::Settings::Type_BlackList,
+                                                   keyVector));
+    write(KeysFile, builder);
+}
+
+void ConfigStore::writeTemplates() const
+{
+    FlatbufferEncoder encoder;
+    auto& builder = encoder.builder();
+    std::vector<flatbuffers::Offset<Disseminate::Config::Template> > out;
+    out.reserve(templates.size());
+    for (auto it = templates.cbegin(); it != templates.cend(); ++it) {
+        std::vector<Disseminate::Settings::Remap> remaps;
+        remaps.reserve(it->remaps.size());
+        for (const KeyRemap& remap : it->remaps) {
+            remaps.emplace_back(Disseminate::Settings::Key(remap.first.first, remap.first.second),
+                                Disseminate::Settings::Key(remap.second.first, remap.second.second));
+        }
+        const auto name = fromQString(builder, it.key());
+        const auto keyVector = writeKeyVector(builder, it->keys);
+        const auto remapVector = builder.CreateVectorOfStructs(remaps);
+        out.push_back(Disseminate::Config::CreateTemplate(builder, name, it->whitelist, keyVector, remapVector));
+    }
+    encoder.finish(Disseminate::Config::CreateTemplates(builder, builder.CreateVector(out)));
+    write(TemplatesFile, builder);
+}
+
+void ConfigStore::writePreferences() const
+{
+    FlatbufferEncoder encoder;
+    auto& builder = encoder.builder();
+    std::vector<flatbuffers::Offset<flatbuffers::String> > windows;
+    windows.reserve(preferences.automaticWindows.size());
+    for (const QString& window : preferences.automaticWindows)
+        windows.push_back(fromQString(builder, window));
+    const auto windowVector = builder.CreateVector(windows);
+    const auto exclusions = writeKeyVector(builder, preferences.exclusions);
+    const Disseminate::Settings::Key toggleKeyboard(preferences.globalKey.first, preferences.globalKey.second);
+    const Disseminate::Settings::Key toggleMouse(preferences.globalMouse.first, preferences.globalMouse.second);
+    encoder.finish(Disseminate::Config::CreatePreferences(builder, &toggleKeyboard, &toggleMouse, exclusions, windowVector));
+    write(PreferencesFile, builder);
+}
+
+QString ConfigStore::iconFile(const Configuration::Item& item) const
+{
+    return QString::fromLatin1(QCryptographicHash::hash(item.appPath.toUtf8(), QCryptographicHash::Sha1).toHex()) + ".png";
+}
+
+void ConfigStore::writeConfigurations()
+{
+    const QString icons = dir + '/' + IconDir;
+    QDir().mkpath(icons);
+    QSet<QString> used;
+
+    FlatbufferEncoder encoder;
+    auto& builder = encoder.builder();
+    std::vector<flatbuffers::Offset<Disseminate::Config::Application> > out;
+    out.reserve(configurations.size());
+    for (const Configuration::Item& item : configurations) {
+        flatbuffers::Offset<flatbuffers::String> icon;
+        if (!item.appIcon.isNull()) {
+            // an app's icon is written once and then only referred to
+            const QString file = iconFile(item);
+            if (QFile::exists(icons + '/' + file) || item.appIcon.save(icons + '/' + file, "PNG")) {
+                used.insert(file);
+                icon = fromQString(builder, file);
+            }
+        }
+        std::vector<flatbuffers::Offset<flatbuffers::String> > clients, groups;
+        clients.reserve(item.clients.size());
+        for (const QString& client : item.clients) {
+            clients.push_back(fromQString(builder, client));
+            if (!item.groups.isEmpty())
+                groups.push_back(fromQString(builder, item.groups.value(client)));
+        }
+        const auto name = fromQString(builder, item.name);
+        const auto appPath = fromQString(builder, item.appPath);
+        const auto clientVector = builder.CreateVector(clients);
+        const auto groupVector = groups.empty() ? flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String> > >()
+                                                : builder.CreateVector(groups);
+        out.push_back(Disseminate::Config::CreateApplication(builder, name, appPath, icon, clientVector, groupVector));
+    }
+    encoder.finish(Disseminate::Config::CreateConfigurations(builder, builder.CreateVector(out)));
+    if (!write(ConfigurationsFile, builder))
+        return;
+
+    // icons of configurations that are gone
+    for (const QString& file : QDir(icons).entryList(QStringList() << "*.png", QDir::Files)) {
+        if (!used.contains(file))
+            QFile::remove(icons + '/' + file);
+    }
+}
+
+void ConfigStore::migrate()
+{
+    QSettings settings("jhanssen", "Disseminate");
+
+    keys.keys = readSettingsKeys(settings.value("keys").toList());
+    keys.whitelist = settings.value("keyType").toString() != "blacklist";
+
+    templates.clear();
+    const QVariantMap temps = settings.value("templates").toMap();
+    for (auto it = temps.cbegin(); it != temps.cend(); ++it) {
+        const QVariantMap ventry = it.value().toMap();
+        if (!ventry.contains("whitelist") || !ventry.contains("keys"))
+            continue;
+        Templates::ConfigItem titem;
+        titem.whitelist = ventry["whitelist"].toBool();
+        titem.keys = readSettingsKeys(ventry["keys"].toList());
+        for (const auto& r : ventry["remaps"].toList()) {
+            const QVariantMap rm = r.toMap();
+            if (rm.contains("fromKey") && rm.contains("fromMask") && rm.contains("toKey") && rm.contains("toMask")) {
+                titem.remaps.append(KeyRemap(KeyCode(rm["fromKey"].toLongLong(), rm["fromMask"].toULongLong()),
+                                             KeyCode(rm["toKey"].toLongLong(), rm["toMask"].toULongLong())));
+            }
+        }
+        templates[it.key()] = titem;
+    }
+
+    preferences.automaticWindows = settings.value("preferences/automaticWindows").toStringList();
+    preferences.globalKey = { 0, 0 };
+    preferences.globalMouse = { 0, 0 };
+    const QVariantMap bindings = settings.value("bindings").toMap();
+    if (bindings.contains("keyboard") && bindings.contains("mouse")) {
+        bool ok;
+        const KeyCode keyboard = readSettingsKey(bindings.value("keyboard").toMap(), &ok);
+        if (ok)
+            preferences.globalKey = keyboard;
+        const KeyCode mouse = readSettingsKey(bindings.value("mouse").toMap(), &ok);
+        if (ok)
+            preferences.globalMouse = mouse;
+    }
+    preferences.exclusions = readSettingsKeys(settings.value("exclusions").toList());
+
+    configurations.clear();
+    for (const auto& config : settings.value("configurations").toList()) {
+        const QVariantMap cm = config.toMap();
+        if (!cm.contains("appPath") || !cm.contains("name"))
+            continue;
+        Configuration::Item item;
+        item.name = cm["name"].toString();
+        item.appPath = cm["appPath"].toString();
+        item.appIcon = cm["appIcon"].value<QPixmap>();
+        item.clients = cm["clients"].toStringList();
+        configurations.append(item);
+    }
+
+    // the QSettings are left alone so an older build still finds them
+    dirty = AllSections;
+    flush();
+}
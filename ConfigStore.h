@@ -0,0 +1,114 @@
+/*
+  Disseminate, keyboard broadcaster
+  Copyright (C) 2016  Jan Erik Hanssen
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONFIGSTORE_H
+#define CONFIGSTORE_H
+
+#include "Configuration.h"
+#include "Helpers.h"
+#include "Preferences.h"
+#include "Templates.h"
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+namespace flatbuffers {
+class FlatBufferBuilder;
+}
+
+// Keeps the controller configuration in a directory of flatbuffer files,
+// one per section (see buffers/Config.fbs). save() only records the new
+// value and marks its section dirty, the dirty sections are written
+// together once changes have settled for a little while. Files are
+// replaced atomically and read back through mmap. App icons aren't
+// stored inline, a configuration refers to a PNG in the icons
+// subdirectory that's written once per app.
+class ConfigStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct KeyList
+    {
+        KeyList() : whitelist(true) { }
+
+        QVector<KeyCode> keys;
+        bool whitelist;
+    };
+
+    ConfigStore(const QString& path = defaultPath(), QObject* parent = 0);
+    ~ConfigStore();
+
+    static QString defaultPath();
+
+    // true if nothing has been stored here yet
+    bool isEmpty() const;
+    // fills the store from the QSettings the controller used to keep its
+    // configuration in and writes every section right away
+    void migrate();
+
+    // each returns false if the section is missing or unreadable
+    bool load(KeyList& keys) const;
+    bool load(Templates::Config& templates) const;
+    bool load(Preferences::Config& preferences) const;
+    bool load(QVector<Configuration::Item>& configurations) const;
+
+    void save(const KeyList& keys);
+    void save(const Templates::Config& templates);
+    void save(const Preferences::Config& preferences);
+    void save(const QVector<Configuration::Item>& configurations);
+
+    // delay is how long changes have to settle, maxDelay caps how long a
+    // steady stream of changes can hold a write back
+    void setDelay(int delay, int maxDelay);
+
+public slots:
+    void flush();
+
+private:
+    enum Section {
+        KeysSection = 0x1,
+        TemplatesSection = 0x2,
+        PreferencesSection = 0x4,
+        ConfigurationsSection = 0x8,
+        AllSections = 0xf
+    };
+
+    void markDirty(Section section);
+    bool write(const QString& name, flatbuffers::FlatBufferBuilder& builder) const;
+    void writeKeys() const;
+    void writeTemplates() const;
+    void writePreferences() const;
+    void writeConfigurations();
+
+    QString iconFile(const Configuration::Item& item) const;
+
+    QString dir;
+    QTimer timer;
+    QElapsedTimer pending;
+    int dirty, delay, maxDelay;
+
+    KeyList keys;
+    Templates::Config templates;
+    Preferences::Config preferences;
+    QVector<Configuration::Item> configurations;
+};
+
+#endif
@@ -20,6 +20,7 @@
 #define CONFIGURATION_H
 
 #include <QDialog>
+#include <QMap>
 #include <QPixmap>
 #include <QStringList>
 
@@ -40,6 +41,8 @@ public:
         QString appPath;
         QPixmap appIcon;
         QStringList clients;
+        // client name to group name, clients without a group aren't in here
+        QMap<QString, QString> groups;
     };
     void setItem(const Item& item);
 
@@ -50,6 +53,7 @@ private slots:
     void selectApplication();
     void addClient();
     void removeClients();
+    void setGroup();
     void emitItemSelected();
 
 private:
@@ -17,7 +17,7 @@
 */
 
 #include "Configuration.h"
-#include "Helpers.h"
+#include "IconCache.h"
 #include "ui_Configuration.h"
 #include <QInputDialog>
 #include <CocoaUtils.h>
@@ -25,6 +25,25 @@
 #include <QDebug>
 #import <Cocoa/Cocoa.h>
 
+enum { ClientRole = Qt::UserRole, GroupRole };
+
+static QListWidgetItem* createClientItem(const QString& client, const QString& group)
+{
+    QListWidgetItem* item = new QListWidgetItem(group.isEmpty() ? client : client + " (" + group + ")");
+    item->setData(ClientRole, client);
+    item->setData(GroupRole, group);
+    return item;
+}
+
+static bool containsClient(const QListWidget* list, const QString& client)
+{
+    for (int i = 0; i < list->count(); ++i) {
+        if (list->item(i)->data(ClientRole).toString() == client)
+            return true;
+    }
+    return false;
+}
+
 Configuration::Configuration(QWidget *parent) :
     QDialog(parent),
     ui(new Ui::Configuration)
@@ -33,6 +52,7 @@ Configuration::Configuration(QWidget *parent) :
     connect(ui->selectApplication, &QPushButton::clicked, this, &Configuration::selectApplication);
     connect(ui->addClient, &QPushButton::clicked, this, &Configuration::addClient);
     connect(ui->removeClient, &QPushButton::clicked, this, &Configuration::removeClients);
+    connect(ui->setGroup, &QPushButton::clicked, this, &Configuration::setGroup);
 
     connect(this, &Configuration::accepted, this, &Configuration::emitItemSelected);
 }
@@ -66,12 +86,9 @@ void Configuration::selectApplication()
             if (bundle) {
                 NSString* appPath = [bundle bundlePath];
                 if (appPath) {
-                    NSImage* appIcon = [[NSWorkspace sharedWorkspace] iconForFile:appPath];
-                    if (appIcon) {
-                        NSRect iconRect = NSMakeRect(0, 0, appIcon.size.width, appIcon.size.height);
-                        CGImageRef cgIcon = [appIcon CGImageForProposedRect:&iconRect context:NULL hints:nil];
-                        ui->application->setIcon(QtMac::fromCGImageRef(cgIcon));
-                    }
+                    const QPixmap appIcon = IconCache::instance()->forPath(QString::fromNSString(appPath));
+                    if (!appIcon.isNull())
+                        ui->application->setIcon(appIcon);
                 }
             }
         }
@@ -82,8 +99,8 @@ void Configuration::addClient()
 {
     const QString client = QInputDialog::getText(this, "Add Client", "Add Client");
     if (!client.isEmpty()) {
-        if (!helpers::contains(ui->clients, client)) {
-            ui->clients->addItem(client);
+        if (!containsClient(ui->clients, client)) {
+            ui->clients->addItem(createClientItem(client, QString()));
         }
     }
 }
@@ -95,6 +112,24 @@ void Configuration::removeClients()
     }
 }
 
+void Configuration::setGroup()
+{
+    const auto items = ui->clients->selectedItems();
+    if (items.isEmpty())
+        return;
+    bool ok;
+    const QString group = QInputDialog::getText(this, "Client Group", "Group (empty for none)", QLineEdit::Normal,
+                                                items.first()->data(GroupRole).toString(), &ok).trimmed();
+    if (!ok)
+        return;
+    for (auto& item : items) {
+        const QString client = item->data(ClientRole).toString();
+        const int row = ui->clients->row(item);
+        delete item;
+        ui->clients->insertItem(row, createClientItem(client, group));
+    }
+}
+
 void Configuration::emitItemSelected()
 {
     Item item;
@@ -105,7 +140,11 @@ void Configuration::emitItemSelected()
     const QListWidget* listWidget = ui->clients;
     for(int i = 0; i < listWidget->count(); ++i) {
         QListWidgetItem* witem = listWidget->item(i);
-        item.clients.append(witem->text());
+        const QString client = witem->data(ClientRole).toString();
+        const QString group = witem->data(GroupRole).toString();
+        item.clients.append(client);
+        if (!group.isEmpty())
+            item.groups[client] = group;
     }
 
     emit itemSelected(item);
@@ -118,8 +157,8 @@ void Configuration::setItem(const Item& item)
     ui->application->setText(item.appPath);
     ui->application->setIcon(item.appIcon);
 
-    removeClients();
+    ui->clients->clear();
     for (const auto& c : item.clients) {
-        ui->clients->addItem(c);
+        ui->clients->addItem(createClientItem(c, item.groups.value(c)));
     }
 }
@@ -0,0 +1,43 @@
+#ifndef CONTROLPROTOCOL_H
+#define CONTROLPROTOCOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+// Framing on the control socket between disseminated and its UIs. Each
+// message is a Header followed by size bytes of payload, type is one of
+// FlatbufferTypes and the payload the same as it would be on a message
+// port. Both ends are on the same machine, so host byte order.
+
+namespace Disseminate {
+namespace Control {
+
+struct Header
+{
+    int32_t type;
+    uint32_t size;
+};
+
+enum { MaxPayload = 16 * 1024 * 1024 };
+
+// DISSEMINATE_CONTROL_SOCKET overrides, otherwise a socket in the per
+// user temporary directory
+inline std::string socketPath()
+{
+    if (const char* path = getenv("DISSEMINATE_CONTROL_SOCKET"))
+        return path;
+    std::string dir;
+    if (const char* tmp = getenv("TMPDIR"))
+        dir = tmp;
+    if (dir.empty())
+        dir = "/tmp";
+    if (dir.back() != '/')
+        dir += '/';
+    return dir + "jhanssen.disseminate.control";
+}
+
+} // namespace Control
+} // namespace Disseminate
+
+#endif
@@ -0,0 +1,247 @@
+#include "ControlServer.h"
+#include "Controller.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static bool makeAddress(const std::string& path, sockaddr_un* addr)
+{
+    memset(addr, 0, sizeof(sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr->sun_path))
+        return false;
+    memcpy(addr->sun_path, path.c_str(), path.size());
+    return true;
+}
+
+static void setNonBlocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+}
+
+ControlServer::ControlServer(Controller* controller, const std::string& path)
+    : mController(controller), mPath(path), mListen(0), mListenSource(0)
+{
+    mController->onNotify([this](int32_t type, const uint8_t* data, size_t size) {
+            send(type, data, size);
+        });
+}
+
+ControlServer::~ControlServer()
+{
+    mController->onNotify(Controller::NotifyCallback());
+    while (!mConnections.empty())
+        close(mConnections.back().get());
+    if (mListen) {
+        CFRunLoopRemoveSource(CFRunLoopGetCurrent(), mListenSource, kCFRunLoopCommonModes);
+        CFRelease(mListenSource);
+        CFSocketInvalidate(mListen);
+        CFRelease(mListen);
+        unlink(mPath.c_str());
+    }
+}
+
+bool ControlServer::listen()
+{
+    sockaddr_un addr;
+    if (!makeAddress(mPath, &addr)) {
+        fprintf(stderr, "control socket path too long: %s\n", mPath.c_str());
+        return false;
+    }
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+        return false;
+    // owner only from the start, a chmod after bind would leave a window
+    const mode_t mask = umask(S_IRWXG | S_IRWXO);
+    bool bound = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    if (!bound && errno == EADDRINUSE) {
+        // left behind by a daemon that died, unless something answers
+        const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        const bool live = connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        ::close(probe);
+        if (live) {
+            fprintf(stderr, "another controller is listening on %s\n", mPath.c_str());
+        } else {
+            unlink(mPath.c_str());
+            bound = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        }
+    }
+    umask(mask);
+    if (!bound) {
+        // listen() on an unbound socket would bind it somewhere nobody looks
+        fprintf(stderr, "can't bind %s: %s\n", mPath.c_str(), strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    if (::listen(fd, 8) == -1) {
+        ::close(fd);
+        return false;
+    }
+    setNonBlocking(fd);
+
+    CFSocketContext ctx;
+    memset(&ctx, 0, sizeof(CFSocketContext));
+    ctx.info = this;
+    mListen = CFSocketCreateWithNative(nullptr, fd, kCFSocketAcceptCallBack, acceptCallback, &ctx);
+    if (!mListen) {
+        ::close(fd);
+        return false;
+    }
+    mListenSource = CFSocketCreateRunLoopSource(nullptr, mListen, 0);
+    CFRunLoopAddSource(CFRunLoopGetCurrent(), mListenSource, kCFRunLoopCommonModes);
+    return true;
+}
+
+void ControlServer::acceptCallback(CFSocketRef, CFSocketCallBackType type, CFDataRef,
+                                   const void* data, void* info)
+{
+    if (type == kCFSocketAcceptCallBack)
+        static_cast<ControlServer*>(info)->accept(*static_cast<const CFSocketNativeHandle*>(data));
+}
+
+void ControlServer::accept(int fd)
+{
+    setNonBlocking(fd);
+
+    std::unique_ptr<Connection> connection(new Connection);
+    connection->server = this;
+
+    CFSocketContext ctx;
+    memset(&ctx, 0, sizeof(CFSocketContext));
+    ctx.info = connection.get();
+    connection->socket = CFSocketCreateWithNative(nullptr, fd, kCFSocketReadCallBack | kCFSocketWriteCallBack,
+                                                  socketCallback, &ctx);
+    if (!connection->socket) {
+        ::close(fd);
+        return;
+    }
+    // writes are only waited for when a send couldn't complete
+    CFSocketDisableCallBacks(connection->socket, kCFSocketWriteCallBack);
+    connection->source = CFSocketCreateRunLoopSource(nullptr, connection->socket, 0);
+    CFRunLoopAddSource(CFRunLoopGetCurrent(), connection->source, kCFRunLoopCommonModes);
+    mConnections.push_back(std::move(connection));
+
+    // the new connection gets the roster along with everyone else
+    mController->notifyRoster();
+}
+
+void ControlServer::socketCallback(CFSocketRef, CFSocketCallBackType type, CFDataRef,
+                                   const void*, void* info)
+{
+    Connection* connection = static_cast<Connection*>(info);
+    if (type == kCFSocketReadCallBack)
+        connection->server->read(connection);
+    else if (type == kCFSocketWriteCallBack)
+        connection->server->flush(connection);
+}
+
+void ControlServer::read(Connection* connection)
+{
+    const int fd = CFSocketGetNative(connection->socket);
+    uint8_t buf[16384];
+    for (;;) {
+        const ssize_t r = recv(fd, buf, sizeof(buf), 0);
+        if (r > 0) {
+            connection->input.insert(connection->input.end(), buf, buf + r);
+            continue;
+        }
+        if (r == 0 || (errno != EAGAIN && errno != EINTR)) {
+            close(connection);
+            return;
+        }
+        if (errno == EAGAIN)
+            break;
+    }
+
+    // handing a command to the controller can end up closing this
+    // connection, so take the complete frames out first
+    std::vector<std::pair<int32_t, std::vector<uint8_t> > > frames;
+    auto& input = connection->input;
+    size_t consumed = 0;
+    while (input.size() - consumed >= sizeof(Disseminate::Control::Header)) {
+        Disseminate::Control::Header header;
+        memcpy(&header, &input[consumed], sizeof(header));
+        if (header.size > Disseminate::Control::MaxPayload) {
+            fprintf(stderr, "control frame too large (%u bytes), dropping connection\n", header.size);
+            close(connection);
+            return;
+        }
+        if (input.size() - consumed - sizeof(header) < header.size)
+            break;
+        const auto payload = input.begin() + consumed + sizeof(header);
+        frames.emplace_back(header.type, std::vector<uint8_t>(payload, payload + header.size));
+        consumed += sizeof(header) + header.size;
+    }
+    input.erase(input.begin(), input.begin() + consumed);
+
+    for (const auto& frame : frames) {
+        mController->handle(frame.first, frame.second.empty() ? nullptr : &frame.second[0], frame.second.size());
+    }
+}
+
+void ControlServer::send(int32_t type, const uint8_t* data, size_t size)
+{
+    Disseminate::Control::Header header = { type, static_cast<uint32_t>(size) };
+    const uint8_t* h = reinterpret_cast<const uint8_t*>(&header);
+    // iterate over a copy, a failing connection closes itself
+    std::vector<Connection*> connections;
+    for (const auto& c : mConnections)
+        connections.push_back(c.get());
+    for (Connection* connection : connections) {
+        if (connection->output.size() + sizeof(header) + size > MaxOutput) {
+            fprintf(stderr, "control connection stopped reading, dropping it\n");
+            close(connection);
+            continue;
+        }
+        connection->output.insert(connection->output.end(), h, h + sizeof(header));
+        if (size)
+            connection->output.insert(connection->output.end(), data, data + size);
+        flush(connection);
+    }
+}
+
+void ControlServer::flush(Connection* connection)
+{
+    auto& output = connection->output;
+    const int fd = CFSocketGetNative(connection->socket);
+    size_t written = 0;
+    while (written < output.size()) {
+        const ssize_t w = ::send(fd, &output[written], output.size() - written, 0);
+        if (w > 0) {
+            written += w;
+        } else if (w == -1 && errno == EINTR) {
+            continue;
+        } else if (w == -1 && errno == EAGAIN) {
+            break;
+        } else {
+            close(connection);
+            return;
+        }
+    }
+    output.erase(output.begin(), output.begin() + written);
+    if (!output.empty())
+        CFSocketEnableCallBacks(connection->socket, kCFSocketWriteCallBack);
+}
+
+void ControlServer::close(Connection* connection)
+{
+    auto it = std::find_if(mConnections.begin(), mConnections.end(),
+                           [connection](const std::unique_ptr<Connection>& c) { return c.get() == connection; });
+    if (it == mConnections.end())
+        return;
+    CFRunLoopRemoveSource(CFRunLoopGetCurrent(), connection->source, kCFRunLoopCommonModes);
+    CFRelease(connection->source);
+    // closes the native socket as well
+    CFSocketInvalidate(connection->socket);
+    CFRelease(connection->socket);
+    mConnections.erase(it);
+}
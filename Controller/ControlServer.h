@@ -0,0 +1,59 @@
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include "ControlProtocol.h"
+#include <CoreFoundation/CoreFoundation.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Controller;
+
+// Puts a Controller on a unix socket, see ControlProtocol.h for the
+// framing. Every connection can send commands and gets every
+// notification, starting with the current roster. Sockets are non
+// blocking and serviced from the current CFRunLoop, a UI that stops
+// reading only grows its own output buffer until it's dropped, it never
+// holds up the controller.
+class ControlServer
+{
+public:
+    ControlServer(Controller* controller, const std::string& path = Disseminate::Control::socketPath());
+    ~ControlServer();
+
+    // false if the socket couldn't be set up, or if another daemon is
+    // already listening on it
+    bool listen();
+
+    size_t connections() const { return mConnections.size(); }
+
+private:
+    struct Connection
+    {
+        ControlServer* server;
+        CFSocketRef socket;
+        CFRunLoopSourceRef source;
+        std::vector<uint8_t> input, output;
+    };
+
+    enum { MaxOutput = 4 * 1024 * 1024 };
+
+    static void acceptCallback(CFSocketRef s, CFSocketCallBackType type, CFDataRef address,
+                               const void* data, void* info);
+    static void socketCallback(CFSocketRef s, CFSocketCallBackType type, CFDataRef address,
+                               const void* data, void* info);
+
+    void accept(int fd);
+    void read(Connection* connection);
+    void flush(Connection* connection);
+    void close(Connection* connection);
+    void send(int32_t type, const uint8_t* data, size_t size);
+
+    Controller* mController;
+    std::string mPath;
+    CFSocketRef mListen;
+    CFRunLoopSourceRef mListenSource;
+    std::vector<std::unique_ptr<Connection> > mConnections;
+};
+
+#endif
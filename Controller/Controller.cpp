@@ -0,0 +1,333 @@
+#include "Controller.h"
+#include "FlatbufferEncoder.h"
+#include "MetricsReport.h"
+#include <FlatbufferTypes.h>
+#include <RemoteAdd_generated.h>
+#include <Identity_generated.h>
+#include <Roster_generated.h>
+#include <PeerState_generated.h>
+#include <stdio.h>
+
+Controller::Controller(const std::string& name)
+    : mPort(name), mNextSenderId(1), mHeartbeat(0)
+{
+    mPort.onMessage([this](int32_t id, const std::vector<uint8_t>& msg) {
+            switch (id) {
+            case Disseminate::FlatbufferTypes::RemoteAdd:
+                registerRemote(msg);
+                break;
+            case Disseminate::FlatbufferTypes::ScriptStats:
+                if (mNotify)
+                    mNotify(id, msg.empty() ? nullptr : &msg[0], msg.size());
+                break;
+            case Disseminate::FlatbufferTypes::Metrics:
+                receiveMetrics(msg);
+                break;
+            case Disseminate::FlatbufferTypes::Heartbeat:
+                receiveHeartbeat(msg);
+                break;
+            default:
+                fprintf(stderr, "controller: unknown message %d\n", id);
+                break;
+            }
+        });
+
+    const double interval = HeartbeatInterval / 1000.;
+    CFRunLoopTimerContext context = { 0, this, 0, 0, 0 };
+    mHeartbeat = CFRunLoopTimerCreate(kCFAllocatorDefault, CFAbsoluteTimeGetCurrent() + interval, interval,
+                                      0, 0, heartbeatCallback, &context);
+    CFRunLoopAddTimer(CFRunLoopGetCurrent(), mHeartbeat, kCFRunLoopCommonModes);
+}
+
+Controller::~Controller()
+{
+    CFRunLoopTimerInvalidate(mHeartbeat);
+    CFRelease(mHeartbeat);
+}
+
+void Controller::handle(int32_t type, const uint8_t* data, size_t size)
+{
+    switch (type) {
+    case Disseminate::FlatbufferTypes::Settings:
+        pushSettings(data, size);
+        break;
+    case Disseminate::FlatbufferTypes::Terminate:
+        if (data)
+            terminate(std::string(reinterpret_cast<const char*>(data), size));
+        break;
+    case Disseminate::FlatbufferTypes::ScriptStatsRequest:
+        for (const auto& p : mPeers) {
+            if (!p.second.degraded)
+                send(p.second, Disseminate::FlatbufferTypes::ScriptStatsRequest);
+        }
+        break;
+    default:
+        fprintf(stderr, "controller: unknown command %d\n", type);
+        break;
+    }
+}
+
+void Controller::registerRemote(const std::vector<uint8_t>& msg)
+{
+    if (msg.empty())
+        return;
+    const auto remoteAdd = Disseminate::RemoteAdd::GetEvent(&msg[0])->UnPack();
+    const int32_t pid = remoteAdd->pid;
+    if (pid <= 0) {
+        fprintf(stderr, "controller: registration from %s without a pid\n", remoteAdd->uuid.c_str());
+        return;
+    }
+    printf("got message %d -> %s (protocol %u, capabilities 0x%llx)\n", pid, remoteAdd->uuid.c_str(),
+           remoteAdd->version, static_cast<unsigned long long>(remoteAdd->capabilities));
+
+    auto existing = mPeers.find(pid);
+    if (existing != mPeers.end() && existing->second.uuid == remoteAdd->uuid) {
+        // the same client again, e.g. retrying after its first send timed
+        // out. Keep its port and sender id: remote ports are shared per
+        // name, a new one would take the old one and the peer down with it
+        Peer& peer = existing->second;
+        peer.client = remoteAdd->client;
+        peer.version = remoteAdd->version;
+        peer.capabilities = remoteAdd->capabilities;
+        peer.missed = 0;
+    } else {
+        if (existing != mPeers.end()) {
+            // the pid went to another client, the old port going away
+            // mustn't take the new entry with it
+            existing->second.port->onInvalidated(MessagePortRemote::InvalidatedCallback());
+            mReports.erase(existing->second.uuid);
+            mPeers.erase(existing);
+        }
+        auto remote = std::make_shared<MessagePortRemote>(remoteAdd->uuid);
+        remote->onInvalidated([this, pid]() {
+                printf("invalidated port\n");
+                auto it = mPeers.find(pid);
+                if (it != mPeers.end()) {
+                    const std::string uuid = it->second.uuid;
+                    mReports.erase(uuid);
+                    mPeers.erase(it);
+                    // drops its handle and degraded state on the other side
+                    for (const auto& p : mPeers) {
+                        if (!p.second.degraded)
+                            send(p.second, Disseminate::FlatbufferTypes::RemoteRemove,
+                                 reinterpret_cast<const uint8_t*>(uuid.c_str()), uuid.size());
+                    }
+                }
+                updateDegraded();
+                Metrics::instance()->gauge("peers").set(mPeers.size());
+                notifyRoster();
+            });
+        // 0 means no id, clients without one fall back to the full tables
+        const uint16_t senderId = mNextSenderId ? mNextSenderId++ : 0;
+        mPeers[pid] = { remoteAdd->uuid, remoteAdd->client, remote, senderId,
+                        remoteAdd->version, remoteAdd->capabilities, 0, false };
+    }
+    Metrics::instance()->counter("registrations").add();
+    Metrics::instance()->gauge("peers").set(mPeers.size());
+    // with settings to go by, a client that registers late, or again after
+    // a controller restart, doesn't have to wait for the next push
+    if (!mSettings.empty()) {
+        for (const auto& p : mPeers) {
+            if (!p.second.degraded)
+                pushPeer(p.second);
+        }
+    }
+    notifyRoster();
+}
+
+void Controller::notifyRoster()
+{
+    if (!mNotify)
+        return;
+    FlatbufferEncoder encoder;
+    auto& builder = encoder.builder();
+    std::vector<flatbuffers::Offset<Disseminate::Roster::Peer> > peers;
+    peers.reserve(mPeers.size());
+    for (const auto& p : mPeers) {
+        peers.push_back(Disseminate::Roster::CreatePeer(builder, p.first,
+                                                        builder.CreateString(p.second.uuid),
+                                                        builder.CreateString(p.second.client),
+                                                        p.second.id, p.second.version,
+                                                        p.second.capabilities, p.second.degraded));
+    }
+    encoder.finish(Disseminate::Roster::CreateEvent(builder, builder.CreateVector(peers)));
+    mNotify(Disseminate::FlatbufferTypes::Roster, encoder.data(), encoder.size());
+}
+
+void Controller::receiveMetrics(const std::vector<uint8_t>& msg)
+{
+    std::vector<Metrics::Source> sources;
+    if (msg.empty() || !decodeMetrics(&msg[0], msg.size(), sources)) {
+        fprintf(stderr, "controller: bad metrics report\n");
+        return;
+    }
+    // clients report themselves under their uuid, drop reports
+    // from anyone that isn't registered
+    for (Metrics::Source& source : sources) {
+        for (const auto& p : mPeers) {
+            if (p.second.uuid == source.name) {
+                mReports[source.name] = std::move(source.samples);
+                break;
+            }
+        }
+    }
+}
+
+std::vector<Metrics::Source> Controller::metrics() const
+{
+    std::vector<Metrics::Source> sources;
+    sources.reserve(mReports.size() + 1);
+    sources.push_back({ "controller", Metrics::instance()->snapshot() });
+    for (const auto& p : mPeers) {
+        auto report = mReports.find(p.second.uuid);
+        if (report == mReports.end())
+            continue;
+        sources.push_back({ p.second.client.empty() ? p.second.uuid : p.second.client, report->second });
+    }
+    return sources;
+}
+
+void Controller::notifyMetrics()
+{
+    if (!mNotify)
+        return;
+    FlatbufferEncoder encoder;
+    encodeMetrics(encoder, metrics());
+    mNotify(Disseminate::FlatbufferTypes::Metrics, encoder.data(), encoder.size());
+}
+
+bool Controller::send(const Peer& peer, int32_t type, const uint8_t* data, size_t size, double timeout)
+{
+    if (peer.port->send(type, data, size, timeout))
+        return true;
+    const std::string& name = peer.client.empty() ? peer.uuid : peer.client;
+    Metrics::instance()->counter(Metrics::labeled("send_failures", "peer", name)).add();
+    return false;
+}
+
+void Controller::pushSettings(const uint8_t* data, size_t size)
+{
+    Metrics::instance()->counter("settings_pushed").add();
+    mSettings.assign(data, data + size);
+    // degraded clients catch up when they answer again
+    for (const auto& p : mPeers) {
+        if (!p.second.degraded)
+            pushPeer(p.second);
+    }
+}
+
+void Controller::pushPeer(const Peer& peer, double timeout)
+{
+    if (!mSettings.empty())
+        send(peer, Disseminate::FlatbufferTypes::Settings, &mSettings[0], mSettings.size(), timeout);
+
+    {
+        Disseminate::Identity::EventT identity;
+        identity.id = peer.id;
+
+        FlatbufferEncoder encoder;
+        encoder.finish(Disseminate::Identity::CreateEvent(encoder.builder(), &identity));
+        send(peer, Disseminate::FlatbufferTypes::Identity, encoder.data(), encoder.size(), timeout);
+    }
+
+    send(peer, Disseminate::FlatbufferTypes::RemoteClear, nullptr, 0, timeout);
+    Disseminate::RemoteAdd::EventT addEvent;
+    for (const auto& o : mPeers) {
+        if (o.second.uuid != peer.uuid) {
+            addEvent.uuid = o.second.uuid;
+            addEvent.id = o.second.id;
+            addEvent.version = o.second.version;
+            addEvent.capabilities = o.second.capabilities;
+
+            FlatbufferEncoder encoder;
+            encoder.finish(Disseminate::RemoteAdd::CreateEvent(encoder.builder(), &addEvent));
+            send(peer, Disseminate::FlatbufferTypes::RemoteAdd, encoder.data(), encoder.size(), timeout);
+        }
+    }
+    for (const auto& o : mPeers) {
+        if (o.second.degraded)
+            sendPeerState(peer, o.second, timeout);
+    }
+}
+
+void Controller::heartbeatCallback(CFRunLoopTimerRef, void* info)
+{
+    static_cast<Controller*>(info)->heartbeat();
+}
+
+void Controller::heartbeat()
+{
+    // a client whose queue is full makes the send wait for the whole
+    // timeout. That's the only wait a hung client costs us
+    std::vector<Peer*> lagging;
+    for (auto& p : mPeers) {
+        Peer& peer = p.second;
+        if (++peer.missed > MissedBeats && !peer.degraded)
+            lagging.push_back(&peer);
+        peer.port->send(Disseminate::FlatbufferTypes::Heartbeat, nullptr, 0, SendTimeout / 1000.);
+    }
+    for (Peer* peer : lagging) {
+        setDegraded(*peer, true);
+    }
+}
+
+void Controller::receiveHeartbeat(const std::vector<uint8_t>& msg)
+{
+    const std::string uuid(msg.begin(), msg.end());
+    for (auto& p : mPeers) {
+        if (p.second.uuid == uuid) {
+            p.second.missed = 0;
+            setDegraded(p.second, false);
+            break;
+        }
+    }
+}
+
+void Controller::setDegraded(Peer& peer, bool degraded)
+{
+    if (peer.degraded == degraded)
+        return;
+    peer.degraded = degraded;
+    printf("%s %s\n", peer.uuid.c_str(), degraded ? "stopped answering" : "answers again");
+
+    for (const auto& p : mPeers) {
+        if (!p.second.degraded && p.second.uuid != peer.uuid)
+            sendPeerState(p.second, peer);
+    }
+    if (degraded)
+        Metrics::instance()->counter("degradations").add();
+    else
+        pushPeer(peer, SendTimeout / 1000.); // it may be gone again already
+    updateDegraded();
+    notifyRoster();
+}
+
+void Controller::updateDegraded()
+{
+    size_t count = 0;
+    for (const auto& p : mPeers) {
+        if (p.second.degraded)
+            ++count;
+    }
+    Metrics::instance()->gauge("peers_degraded").set(count);
+}
+
+void Controller::sendPeerState(const Peer& to, const Peer& about, double timeout)
+{
+    FlatbufferEncoder encoder;
+    auto& builder = encoder.builder();
+    encoder.finish(Disseminate::PeerState::CreateEvent(builder, builder.CreateString(about.uuid), about.degraded));
+    send(to, Disseminate::FlatbufferTypes::PeerState, encoder.data(), encoder.size(), timeout);
+}
+
+void Controller::terminate(const std::string& client)
+{
+    for (const auto& p : mPeers) {
+        if (p.second.client == client) {
+            // a client that's stuck won't drain its port, don't wait for it here.
+            // The launcher escalates if it doesn't go away
+            send(p.second, Disseminate::FlatbufferTypes::Terminate, nullptr, 0, 0.25);
+            break;
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include "MessagePort.h"
+#include "Metrics.h"
+#include <CoreFoundation/CFRunLoop.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The broadcast controller without any UI. Serves the port clients
+// register with (a RemoteAdd carrying the client's pid), keeps the roster
+// of registered clients and fans settings out to them. Commands come in through handle(), keyed on FlatbufferTypes
+// with the payload a client would get for the same type:
+//
+//   Settings            a Settings.Global, pushed to every client
+//                       together with its identity and its peers, and
+//                       again to everyone when a client registers
+//   Terminate           the client name
+//   ScriptStatsRequest  nothing, replies come back as ScriptStats
+//
+// What goes the other way (Roster, ScriptStats and Metrics) is passed to
+// onNotify.
+//
+// Every client gets a heartbeat each HeartbeatInterval ms. One that
+// hasn't answered MissedBeats of them is degraded: the controller stops
+// sending it anything but heartbeats and tells the other clients to leave
+// it out as well, so a frozen client doesn't make everyone else wait on
+// its port. It's brought up to date when it answers again. Clients that go
+// away are removed from everyone else's list.
+// disseminated puts both on the control socket, the UI calls them
+// directly when it runs a controller of its own.
+class Controller
+{
+public:
+    struct Peer
+    {
+        std::string uuid, client;
+        std::shared_ptr<MessagePortRemote> port;
+        // sender id for compact events, never reused while we run
+        uint16_t id;
+        // handshake, see Protocol.h
+        uint32_t version;
+        uint64_t capabilities;
+        // heartbeats sent since the last answer
+        uint32_t missed;
+        bool degraded;
+    };
+
+    // SendTimeout (ms) bounds sends to clients that may not be answering:
+    // heartbeats and catching up a client that has just recovered
+    enum { HeartbeatInterval = 1000, MissedBeats = 3, SendTimeout = 50 };
+
+    Controller(const std::string& name = "jhanssen.disseminate.server");
+    ~Controller();
+
+    bool isValid() const { return mPort.isValid(); }
+
+    void handle(int32_t type, const uint8_t* data, size_t size);
+
+    typedef std::function<void(int32_t type, const uint8_t* data, size_t size)> NotifyCallback;
+    void onNotify(const NotifyCallback& on) { mNotify = on; }
+
+    // sends the current roster to onNotify
+    void notifyRoster();
+
+    // sends our own metrics and the last report of every client to onNotify
+    void notifyMetrics();
+    // the same as sources, ours is named "controller" and clients go by
+    // their client name if they have one
+    std::vector<Metrics::Source> metrics() const;
+
+    const std::map<int32_t, Peer>& peers() const { return mPeers; }
+
+private:
+    void registerRemote(const std::vector<uint8_t>& msg);
+    void pushSettings(const uint8_t* data, size_t size);
+    // settings, identity and peers for one client
+    void pushPeer(const Peer& peer, double timeout = 10.0);
+    void terminate(const std::string& client);
+    void receiveMetrics(const std::vector<uint8_t>& msg);
+    bool send(const Peer& peer, int32_t type, const uint8_t* data = nullptr, size_t size = 0, double timeout = 10.0);
+
+    static void heartbeatCallback(CFRunLoopTimerRef timer, void* info);
+    void heartbeat();
+    void receiveHeartbeat(const std::vector<uint8_t>& msg);
+    void setDegraded(Peer& peer, bool degraded);
+    void updateDegraded();
+    void sendPeerState(const Peer& to, const Peer& about, double timeout = 10.0);
+
+    MessagePortLocal mPort;
+    std::map<int32_t, Peer> mPeers;
+    uint16_t mNextSenderId;
+    CFRunLoopTimerRef mHeartbeat;
+    // the last Settings.Global pushed, for clients that come back
+    std::vector<uint8_t> mSettings;
+    NotifyCallback mNotify;
+    // last report from each client, keyed on uuid
+    std::map<std::string, std::vector<Metrics::Sample> > mReports;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "MetricsExporter.h"
+#include "Controller.h"
+#include <stdio.h>
+
+MetricsExporter::MetricsExporter(Controller* controller, const std::string& path, double interval)
+    : mController(controller), mPath(path), mInterval(interval), mTimer(0)
+{
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    stop();
+}
+
+void MetricsExporter::start()
+{
+    if (mTimer)
+        return;
+    CFRunLoopTimerContext context = { 0, this, 0, 0, 0 };
+    mTimer = CFRunLoopTimerCreate(kCFAllocatorDefault, CFAbsoluteTimeGetCurrent() + mInterval, mInterval,
+                                  0, 0, timerCallback, &context);
+    CFRunLoopAddTimer(CFRunLoopGetCurrent(), mTimer, kCFRunLoopCommonModes);
+}
+
+void MetricsExporter::stop()
+{
+    if (!mTimer)
+        return;
+    CFRunLoopTimerInvalidate(mTimer);
+    CFRelease(mTimer);
+    mTimer = 0;
+}
+
+void MetricsExporter::timerCallback(CFRunLoopTimerRef, void* info)
+{
+    MetricsExporter* exporter = static_cast<MetricsExporter*>(info);
+    exporter->mController->notifyMetrics();
+    exporter->write();
+}
+
+bool MetricsExporter::write()
+{
+    if (mPath.empty())
+        return false;
+    const std::string text = Metrics::formatText(mController->metrics());
+    const std::string tmp = mPath + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f)
+        return false;
+    const bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    if (fclose(f) != 0 || !ok || rename(tmp.c_str(), mPath.c_str()) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <stdlib.h>
+#include <string>
+
+class Controller;
+
+// Every interval seconds, sends the controller's metrics to onNotify and
+// writes them in Prometheus text format to a file that a node exporter
+// textfile collector, or anything else, can pick up. The file is replaced
+// with a rename so readers never see half of it. Runs off the current
+// CFRunLoop.
+class MetricsExporter
+{
+public:
+    MetricsExporter(Controller* controller, const std::string& path = defaultPath(), double interval = 2.0);
+    ~MetricsExporter();
+
+    void start();
+    void stop();
+
+    // writes the file now, false if it couldn't be written
+    bool write();
+
+    // DISSEMINATE_METRICS_FILE overrides, otherwise a file in the per
+    // user temporary directory
+    static std::string defaultPath()
+    {
+        if (const char* path = getenv("DISSEMINATE_METRICS_FILE"))
+            return path;
+        std::string dir;
+        if (const char* tmp = getenv("TMPDIR"))
+            dir = tmp;
+        if (dir.empty())
+            dir = "/tmp";
+        if (dir.back() != '/')
+            dir += '/';
+        return dir + "jhanssen.disseminate.metrics";
+    }
+
+private:
+    static void timerCallback(CFRunLoopTimerRef timer, void* info);
+
+    Controller* mController;
+    std::string mPath;
+    double mInterval;
+    CFRunLoopTimerRef mTimer;
+};
+
+#endif
@@ -0,0 +1,43 @@
+// disseminated, the broadcast controller on its own. Serves the message
+// port clients register with and a control socket for UIs, see
+// ControlServer.h. Metrics are written out as text every couple of
+// seconds, see MetricsExporter.h.
+//
+// disseminated [socket path]
+
+#include "Controller.h"
+#include "ControlServer.h"
+#include "MetricsExporter.h"
+#include <CoreFoundation/CoreFoundation.h>
+#include <signal.h>
+#include <stdio.h>
+
+static volatile sig_atomic_t sQuit = 0;
+
+static void quit(int)
+{
+    sQuit = 1;
+}
+
+int main(int argc, char** argv)
+{
+    Controller controller;
+    if (!controller.isValid()) {
+        fprintf(stderr, "unable to serve the controller port, is another controller running?\n");
+        return 1;
+    }
+    ControlServer server(&controller, argc > 1 ? std::string(argv[1]) : Disseminate::Control::socketPath());
+    if (!server.listen())
+        return 1;
+    MetricsExporter exporter(&controller);
+    exporter.start();
+
+    signal(SIGINT, quit);
+    signal(SIGTERM, quit);
+    signal(SIGPIPE, SIG_IGN);
+
+    // CFRunLoopStop isn't safe from a signal handler, poll for it instead
+    while (!sQuit)
+        CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0.5, false);
+    return 0;
+}
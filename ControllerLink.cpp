@@ -0,0 +1,206 @@
+/*
+  Disseminate, keyboard broadcaster
+  Copyright (C) 2016  Jan Erik Hanssen
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ControllerLink.h"
+#include "Controller.h"
+#include "ControlProtocol.h"
+#include "MetricsExporter.h"
+#include <FlatbufferTypes.h>
+#include <Roster_generated.h>
+#include <QLocalSocket>
+#include <string.h>
+
+ControllerLink::ControllerLink(QObject* parent)
+    : QObject(parent), socket(new QLocalSocket(this)), available(true)
+{
+    connect(socket, &QLocalSocket::readyRead, this, &ControllerLink::readSocket);
+    connect(socket, &QLocalSocket::connected, this, &ControllerLink::connected);
+    connect(socket, &QLocalSocket::disconnected, this, &ControllerLink::disconnected);
+    retryTimer.setInterval(RetryInterval);
+    connect(&retryTimer, &QTimer::timeout, this, &ControllerLink::retry);
+}
+
+ControllerLink::~ControllerLink()
+{
+}
+
+void ControllerLink::start()
+{
+    // a unix socket that isn't there fails right away, the timeout only
+    // matters for a daemon that's alive but busy
+    socket->connectToServer(QString::fromStdString(Disseminate::Control::socketPath()));
+    if (!socket->waitForConnected(500))
+        runLocal();
+}
+
+bool ControllerLink::runLocal()
+{
+    socket->abort();
+    std::unique_ptr<Controller> local(new Controller);
+    if (!local->isValid()) {
+        // most likely a daemon that was too slow to answer. Running next
+        // to it would leave us with no clients and clobber its metrics
+        // file, keep trying to reach it instead
+        if (!retryTimer.isActive()) {
+            qWarning("ControllerLink: the controller port is taken but the daemon doesn't answer");
+            retryTimer.start();
+        }
+        setAvailable(false);
+        return false;
+    }
+    retryTimer.stop();
+    controller = std::move(local);
+    controller->onNotify([this](int32_t type, const uint8_t* data, size_t size) {
+            received(type, data, size);
+        });
+    exporter.reset(new MetricsExporter(controller.get()));
+    exporter->start();
+    // clients that come over from a daemon get these when they register
+    if (!settings.isEmpty())
+        controller->handle(Disseminate::FlatbufferTypes::Settings,
+                           reinterpret_cast<const uint8_t*>(settings.constData()), settings.size());
+    setAvailable(true);
+    return true;
+}
+
+void ControllerLink::retry()
+{
+    if (socket->state() != QLocalSocket::UnconnectedState)
+        return;
+    // the daemon may be gone by now, then the port is ours. Otherwise see
+    // if it answers this time
+    if (!runLocal())
+        socket->connectToServer(QString::fromStdString(Disseminate::Control::socketPath()));
+}
+
+void ControllerLink::connected()
+{
+    if (!retryTimer.isActive())
+        return;
+    retryTimer.stop();
+    setAvailable(true);
+    if (!settings.isEmpty())
+        send(Disseminate::FlatbufferTypes::Settings,
+             reinterpret_cast<const uint8_t*>(settings.constData()), settings.size());
+}
+
+void ControllerLink::setAvailable(bool on)
+{
+    if (available == on)
+        return;
+    available = on;
+    emit availabilityChanged(on);
+}
+
+void ControllerLink::disconnected()
+{
+    if (controller)
+        return;
+    // the daemon went away but its clients didn't. They register again
+    // once they notice the controller port is gone, the roster fills up
+    // as they do
+    qWarning("ControllerLink: lost the controller daemon, running in process");
+    input.clear();
+    roster.clear();
+    emit rosterChanged();
+    runLocal();
+}
+
+void ControllerLink::pushSettings(const uint8_t* data, size_t size)
+{
+    settings = QByteArray(reinterpret_cast<const char*>(data), size);
+    send(Disseminate::FlatbufferTypes::Settings, data, size);
+}
+
+void ControllerLink::terminate(const QString& client)
+{
+    const QByteArray name = client.toUtf8();
+    send(Disseminate::FlatbufferTypes::Terminate, reinterpret_cast<const uint8_t*>(name.constData()), name.size());
+}
+
+void ControllerLink::requestScriptStats()
+{
+    send(Disseminate::FlatbufferTypes::ScriptStatsRequest, nullptr, 0);
+}
+
+void ControllerLink::send(int32_t type, const uint8_t* data, size_t size)
+{
+    if (controller) {
+        controller->handle(type, data, size);
+        return;
+    }
+    if (socket->state() != QLocalSocket::ConnectedState)
+        return;
+    const Disseminate::Control::Header header = { type, static_cast<uint32_t>(size) };
+    socket->write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (size)
+        socket->write(reinterpret_cast<const char*>(data), size);
+}
+
+void ControllerLink::readSocket()
+{
+    input.append(socket->readAll());
+    int consumed = 0;
+    while (input.size() - consumed >= static_cast<int>(sizeof(Disseminate::Control::Header))) {
+        Disseminate::Control::Header header;
+        memcpy(&header, input.constData() + consumed, sizeof(header));
+        if (header.size > Disseminate::Control::MaxPayload) {
+            qWarning("ControllerLink: bad frame from the controller daemon");
+            socket->abort();
+            return;
+        }
+        if (static_cast<uint32_t>(input.size() - consumed) - sizeof(header) < header.size)
+            break;
+        const uint8_t* payload = reinterpret_cast<const uint8_t*>(input.constData()) + consumed + sizeof(header);
+        consumed += sizeof(header) + header.size;
+        received(header.type, payload, header.size);
+    }
+    input.remove(0, consumed);
+}
+
+void ControllerLink::received(int32_t type, const uint8_t* data, size_t size)
+{
+    switch (type) {
+    case Disseminate::FlatbufferTypes::Roster: {
+        if (!size)
+            break;
+        flatbuffers::Verifier verifier(data, size);
+        if (!Disseminate::Roster::VerifyEventBuffer(verifier))
+            break;
+        roster.clear();
+        if (const auto peers = Disseminate::Roster::GetEvent(data)->peers()) {
+            for (const Disseminate::Roster::Peer* peer : *peers) {
+                Peer p;
+                p.uuid = QString::fromStdString(peer->uuid() ? peer->uuid()->str() : std::string());
+                p.client = QString::fromStdString(peer->client() ? peer->client()->str() : std::string());
+                p.degraded = peer->degraded();
+                roster[peer->pid()] = p;
+            }
+        }
+        emit rosterChanged();
+        break; }
+    case Disseminate::FlatbufferTypes::ScriptStats:
+        emit scriptStats(QByteArray(reinterpret_cast<const char*>(data), size));
+        break;
+    case Disseminate::FlatbufferTypes::Metrics:
+        emit metrics(QByteArray(reinterpret_cast<const char*>(data), size));
+        break;
+    default:
+        break;
+    }
+}
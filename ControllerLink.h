@@ -0,0 +1,99 @@
+/*
+  Disseminate, keyboard broadcaster
+  Copyright (C) 2016  Jan Erik Hanssen
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONTROLLERLINK_H
+#define CONTROLLERLINK_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <memory>
+
+class Controller;
+class MetricsExporter;
+class QLocalSocket;
+
+// The UI's way to the broadcast controller. Talks to disseminated over
+// its control socket when one is running, otherwise runs a Controller in
+// this process. Either way commands and notifications have the same
+// FlatbufferTypes ids and payloads, see Controller.h.
+class ControllerLink : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Peer
+    {
+        QString uuid, client;
+        // not answering heartbeats, see Controller.h
+        bool degraded;
+    };
+
+    ControllerLink(QObject* parent = 0);
+    ~ControllerLink();
+
+    void start();
+    bool isRemote() const { return !controller; }
+    // false while another process holds the controller port but we can't
+    // reach it over the control socket, commands go nowhere then
+    bool isAvailable() const { return available; }
+
+    // a finished Settings.Global
+    void pushSettings(const uint8_t* data, size_t size);
+    void terminate(const QString& client);
+    void requestScriptStats();
+
+    // keyed on pid
+    const QMap<int32_t, Peer>& peers() const { return roster; }
+
+signals:
+    void rosterChanged();
+    void availabilityChanged(bool available);
+    void scriptStats(const QByteArray& data);
+    // a Metrics.Report with the controller and every client that reported
+    void metrics(const QByteArray& data);
+
+private slots:
+    void readSocket();
+    void connected();
+    void disconnected();
+    void retry();
+
+private:
+    enum { RetryInterval = 1000 };
+
+    // false if the controller port is taken
+    bool runLocal();
+    void setAvailable(bool on);
+    void send(int32_t type, const uint8_t* data, size_t size);
+    void received(int32_t type, const uint8_t* data, size_t size);
+
+    QLocalSocket* socket;
+    QTimer retryTimer;
+    bool available;
+    std::unique_ptr<Controller> controller;
+    std::unique_ptr<MetricsExporter> exporter;
+    QByteArray input;
+    QMap<int32_t, Peer> roster;
+    // the last settings pushed, for a controller we start later
+    QByteArray settings;
+};
+
+#endif
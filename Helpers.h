@@ -25,6 +25,7 @@
 #include "Utils.h"
 
 typedef QPair<int64_t, uint64_t> KeyCode;
+typedef QPair<KeyCode, KeyCode> KeyRemap;
 
 namespace helpers {
 inline bool contains(QListWidget* listWidget, const QString &text)
@@ -63,6 +64,11 @@ inline bool keyIsNull(const KeyCode& code)
     return (!code.first && !code.second);
 }
 
+inline QString remapToQString(const KeyRemap& remap)
+{
+    return keyToQString(remap.first) + " -> " + keyToQString(remap.second);
+}
+
 class ScreenShotWidget : public QWidget
 {
 public:
@@ -76,29 +82,29 @@ public:
     void setPixmap(const QPixmap& pm)
     {
         pixmap = pm;
+        scaled = QPixmap();
+        update();
     }
 
 protected:
+    void resizeEvent(QResizeEvent*)
+    {
+        scaled = QPixmap();
+    }
+
     void paintEvent(QPaintEvent*)
     {
         QPainter painter(this);
-        if (!pixmap.isNull()) {
-            QRect wr = rect();
-            const double fracx = static_cast<double>(wr.width()) / pixmap.width();
-            const double fracy = static_cast<double>(wr.height()) / pixmap.height();
-            if (fracx < fracy) {
-                // ratio for width
-                wr.setHeight(pixmap.height() * fracx);
-            } else {
-                // ratio for height
-                wr.setWidth(pixmap.width() * fracy);
-            }
-            painter.drawPixmap(wr, pixmap);
-        }
+        if (pixmap.isNull())
+            return;
+        // scale once per size rather than on every paint
+        if (scaled.isNull())
+            scaled = pixmap.scaled(size(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        painter.drawPixmap(0, 0, scaled);
     }
 
 private:
-    QPixmap pixmap;
+    QPixmap pixmap, scaled;
 };
 } // namespace helpers
 
@@ -0,0 +1,59 @@
+/*
+  Disseminate, keyboard broadcaster
+  Copyright (C) 2016  Jan Erik Hanssen
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+
+#include <QHash>
+#include <QPixmap>
+#include <QString>
+#include <list>
+#include <unistd.h>
+
+// Application icons, decoded once and shared. Entries are keyed by bundle
+// identifier, or by executable/file path for things that aren't bundles,
+// so every window of the same app gets the same QPixmap data. The least
+// recently used entry goes once the cache is full.
+class IconCache
+{
+public:
+    static IconCache* instance();
+
+    QPixmap forApplication(pid_t pid);
+    QPixmap forPath(const QString& path);
+
+    void setCapacity(int capacity);
+    int capacity() const { return mCapacity; }
+    int size() const { return mIndex.size(); }
+
+private:
+    IconCache();
+    IconCache(const IconCache&) = delete;
+    IconCache& operator=(const IconCache&) = delete;
+
+    typedef std::list<std::pair<QString, QPixmap> > Entries;
+
+    bool lookup(const QString& key, QPixmap* icon);
+    void insert(const QString& key, const QPixmap& icon);
+
+    int mCapacity;
+    Entries mEntries; // most recently used first
+    QHash<QString, Entries::iterator> mIndex;
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+    Disseminate, keyboard broadcaster
+    Copyright (C) 2016  Jan Erik Hanssen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "IconCache.h"
+#include "CocoaUtils.h"
+#import <Cocoa/Cocoa.h>
+#include <QtMac>
+#include <algorithm>
+
+static QPixmap toPixmap(NSImage* image)
+{
+    if (!image)
+        return QPixmap();
+    NSRect iconRect = NSMakeRect(0, 0, image.size.width, image.size.height);
+    CGImageRef cgIcon = [image CGImageForProposedRect:&iconRect context:NULL hints:nil];
+    return QtMac::fromCGImageRef(cgIcon);
+}
+
+IconCache::IconCache()
+    : mCapacity(64)
+{
+}
+
+IconCache* IconCache::instance()
+{
+    static IconCache cache;
+    return &cache;
+}
+
+bool IconCache::lookup(const QString& key, QPixmap* icon)
+{
+    const auto it = mIndex.find(key);
+    if (it == mIndex.end())
+        return false;
+    mEntries.splice(mEntries.begin(), mEntries, it.value());
+    *icon = mEntries.front().second;
+    return true;
+}
+
+void IconCache::insert(const QString& key, const QPixmap& icon)
+{
+    mEntries.emplace_front(key, icon);
+    mIndex[key] = mEntries.begin();
+    while (mIndex.size() > mCapacity) {
+        mIndex.remove(mEntries.back().first);
+        mEntries.pop_back();
+    }
+}
+
+void IconCache::setCapacity(int capacity)
+{
+    mCapacity = std::max(capacity, 1);
+    while (mIndex.size() > mCapacity) {
+        mIndex.remove(mEntries.back().first);
+        mEntries.pop_back();
+    }
+}
+
+QPixmap IconCache::forApplication(pid_t pid)
+{
+    ScopedPool pool;
+    NSRunningApplication* app = [NSRunningApplication runningApplicationWithProcessIdentifier:pid];
+    if (!app)
+        return QPixmap();
+
+    QString key;
+    if (NSString* bundle = [app bundleIdentifier])
+        key = QString::fromNSString(bundle);
+    else if (NSURL* executable = [app executableURL])
+        key = QString::fromNSString([executable path]);
+
+    QPixmap icon;
+    if (!key.isEmpty() && lookup(key, &icon))
+        return icon;
+    icon = toPixmap([app icon]);
+    if (!key.isEmpty())
+        insert(key, icon);
+    return icon;
+}
+
+QPixmap IconCache::forPath(const QString& path)
+{
+    if (path.isEmpty())
+        return QPixmap();
+    ScopedPool pool;
+    NSString* nspath = path.toNSString();
+
+    QString key = path;
+    if (NSBundle* bundle = [NSBundle bundleWithPath:nspath]) {
+        if (NSString* identifier = [bundle bundleIdentifier])
+            key = QString::fromNSString(identifier);
+    }
+
+    QPixmap icon;
+    if (lookup(key, &icon))
+        return icon;
+    icon = toPixmap([[NSWorkspace sharedWorkspace] iconForFile:nspath]);
+    insert(key, icon);
+    return icon;
+}
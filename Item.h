@@ -19,6 +19,7 @@
 #ifndef ITEM_H
 #define ITEM_H
 
+#include "Helpers.h"
 #include <QListWidgetItem>
 #include <QPixmap>
 
@@ -53,4 +54,15 @@ public:
     uint64_t mask;
 };
 
+class RemapItem : public QListWidgetItem
+{
+public:
+    RemapItem(const KeyRemap& r)
+        : QListWidgetItem(helpers::remapToQString(r)), remap(r)
+    {
+    }
+
+    KeyRemap remap;
+};
+
 #endif
@@ -22,22 +22,25 @@
 #include "Utils.h"
 #include "Helpers.h"
 #include "TemplateChooser.h"
+#include "MetricsPanel.h"
+#include "FlatbufferEncoder.h"
 #include "ui_MainWindow.h"
 #include <memory>
 #include <FlatbufferTypes.h>
 #include <Settings_generated.h>
-#include <RemoteAdd_generated.h>
+#include <ScriptStats_generated.h>
 #include <QFile>
-#include <QProcess>
+#include <QProcessEnvironment>
 #include <QMessageBox>
-#include <QSettings>
+#include <QStatusBar>
 #include <QTimer>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::Disseminate),
     broadcasting(false),
-    messagePort("jhanssen.disseminate.server")
+    windowInventory(createWindowServerProvider()),
+    metricsPanel(new MetricsPanel(this))
 {
     ui->setupUi(this);
 
@@ -51,6 +54,8 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionTemplates, &QAction::triggered, this, &MainWindow::templates);
 
     connect(ui->actionPreferences, &QAction::triggered, this, &MainWindow::preferences);
+    connect(ui->actionScriptStats, &QAction::triggered, this, &MainWindow::requestScriptStats);
+    connect(ui->actionMetrics, &QAction::triggered, metricsPanel, &MetricsPanel::show);
 
     connect(ui->addKey, &QPushButton::clicked, this, &MainWindow::addKey);
     connect(ui->removeKey, &QPushButton::clicked, this, &MainWindow::removeKey);
@@ -65,22 +70,81 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionRemoveConfiguration, &QAction::triggered, this, &MainWindow::removeConfiguration);
     connect(ui->actionEditConfiguration, &QAction::triggered, this, &MainWindow::editConfiguration);
 
-    messagePort.onMessage([this](int32_t id, const std::vector<uint8_t>& msg) {
-            const auto remoteAdd = Disseminate::RemoteAdd::GetEvent(&msg[0])->UnPack();
-            printf("got message %d -> %s\n", id, remoteAdd->uuid.c_str());
-
-            auto remote = std::make_shared<MessagePortRemote>(remoteAdd->uuid);
-            // std::weak_ptr<MessagePortRemote> weak = remote;
-            remote->onInvalidated([this, id/*, weak*/]() {
-                    // if (auto shared = weak.lock()) {
-                    // }
-                    printf("invalidated port\n");
-                    remotePorts.erase(id);
-                    reloadClients();
-                });
-            remotePorts[id] = { remoteAdd->uuid, remoteAdd->client, 0, remote };
-            reloadClients();
+    launcher.onTerminate([this](const QString& client) {
+            terminate(client);
         });
+    connect(&launcher, &ClientLauncher::failed, [this](const QString& client, const QString& error) {
+            statusBar()->showMessage("Launch error for " + client + ": " + error, 5000);
+        });
+    connect(&launcher, &ClientLauncher::progress, [this](int stopped, int total) {
+            statusBar()->showMessage(QString("Stopping clients, %1 of %2 done").arg(stopped).arg(total));
+        });
+    connect(&launcher, &ClientLauncher::stopped, [this]() {
+            statusBar()->showMessage("All clients stopped", 3000);
+            ui->actionStart->setEnabled(true);
+        });
+
+    connect(&link, &ControllerLink::rosterChanged, this, &MainWindow::reloadClients);
+    connect(&link, &ControllerLink::scriptStats, this, &MainWindow::scriptStatsReceived);
+    connect(&link, &ControllerLink::metrics, metricsPanel, &MetricsPanel::setReport);
+    connect(&link, &ControllerLink::availabilityChanged, [this](bool available) {
+            if (available)
+                statusBar()->showMessage("Connected to the controller", 3000);
+            else
+                statusBar()->showMessage("The controller daemon isn't answering, retrying");
+        });
+    link.start();
+}
+
+void MainWindow::requestScriptStats()
+{
+    link.requestScriptStats();
+}
+
+void MainWindow::scriptStatsReceived(const QByteArray& msg)
+{
+    if (msg.isEmpty())
+        return;
+    const auto stats = Disseminate::ScriptStats::GetStats(msg.constData())->UnPack();
+
+    int32_t pid = 0;
+    const QString uuid = QString::fromStdString(stats->uuid);
+    const auto& peers = link.peers();
+    for (auto r = peers.cbegin(); r != peers.cend(); ++r) {
+        if (r->uuid == uuid) {
+            pid = r.key();
+            break;
+        }
+    }
+    if (!pid)
+        return;
+
+    QString text = "Instruction budget: " + (stats->budget ? QString::number(stats->budget) : QString("none"));
+    text += QString("\nLua memory: %1 bytes in %2 allocations").arg(stats->memoryBytes).arg(stats->memoryAllocations);
+    text += QString("\nLua gc: %1 slices, %2us total, max slice %3us")
+        .arg(stats->gcSlices)
+        .arg(stats->gcTime / 1000.0, 0, 'f', 1)
+        .arg(stats->gcMaxSlice / 1000.0, 0, 'f', 1);
+    for (const auto& h : stats->handlers) {
+        const uint64_t avg = h->invocations ? h->totalTime / h->invocations : 0;
+        text += QString("\n%1 handler %2: %3 calls, avg %4us, max %5us, %6 instructions, %7 aborted")
+            .arg(h->kind == Disseminate::ScriptStats::Kind_Mouse ? "mouse" : "key")
+            .arg(h->index + 1)
+            .arg(h->invocations)
+            .arg(avg / 1000.0, 0, 'f', 1)
+            .arg(h->maxTime / 1000.0, 0, 'f', 1)
+            .arg(h->instructions)
+            .arg(h->aborted);
+    }
+
+    const int count = ui->clientList->count();
+    for (int i = 0; i < count; ++i) {
+        ClientItem* item = static_cast<ClientItem*>(ui->clientList->item(i));
+        if (item->wpid == pid) {
+            item->setToolTip(text);
+            break;
+        }
+    }
 }
 
 MainWindow::~MainWindow()
@@ -88,6 +152,7 @@ MainWindow::~MainWindow()
     //broadcast::stop();
     //broadcast::cleanup();
     stopBroadcast();
+    launcher.waitForShutdown();
     delete ui;
 }
 
@@ -130,43 +195,29 @@ void MainWindow::startBroadcast()
 
 void MainWindow::terminate(const QString client)
 {
-    // find the uuid
-    const auto c = client.toStdString();
-    for (auto p : remotePorts) {
-        if (p.second.client == c) {
-            p.second.port->send(Disseminate::FlatbufferTypes::Terminate);
-            break;
-        }
-    }
+    link.terminate(client);
 }
 
 void MainWindow::stopBroadcast()
 {
     if (!broadcasting)
         return;
-    ui->actionStart->setEnabled(true);
     ui->actionStop->setEnabled(false);
 #warning implement me
     //broadcast::stop();
     broadcasting = false;
 
-    // Qt sucks balls, why can't I get a pair from QMap in a ranged for loop???
-    {
-        auto r = running.begin();
-        const auto end = running.end();
-        while (r != end) {
-            terminate(r.key());
-            (*r)->waitForFinished();
-            ++r;
-        }
-    }
-    qDeleteAll(running);
-    running.clear();
+    // start is enabled again once every client is gone, see the
+    // launcher's stopped signal
+    if (launcher.isEmpty())
+        ui->actionStart->setEnabled(true);
+    else
+        launcher.shutdown();
 }
 
 void MainWindow::launchClients()
 {
-    if (!running.isEmpty())
+    if (!launcher.isEmpty())
         return;
     const Configuration::Item* config = currentConfiguration();
     if (!config)
@@ -191,19 +242,9 @@ void MainWindow::launchClients()
         //QMessageBox::critical(0, swizzlerPath, swizzlerPath);
         app = "\"" + app + "\"";
         if (QFile::exists(swizzlerPath)) {
-            for (const auto& client : config->clients) {
-                QProcess* proc = new QProcess(this);
-                connect(proc, &QProcess::errorOccurred, [proc](QProcess::ProcessError error) {
-                        QMessageBox::critical(0, "Launch error", "Launch error " + proc->errorString());
-                    });
-                QProcessEnvironment env = proc->processEnvironment();
-                env.insert("DYLD_INSERT_LIBRARIES", swizzlerPath);
-                env.insert("DISSEMINATE_CLIENT", client);
-                proc->setProcessEnvironment(env);
-                proc->start(app);
-
-                running[client] = proc;
-            }
+            QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+            env.insert("DYLD_INSERT_LIBRARIES", swizzlerPath);
+            launcher.launch(app, env, config->clients);
         }
     }
 }
@@ -229,38 +270,41 @@ void MainWindow::pushSettings()
         global.activeExclusions.push_back({ ex.first, ex.second });
     }
 
-    {
-        flatbuffers::FlatBufferBuilder builder;
-        auto buffer = Disseminate::Settings::CreateGlobal(builder, &global);
-        builder.Finish(buffer);
-
-        std::vector<uint8_t> message(builder.GetBufferPointer(),
-                                     builder.GetBufferPointer() + builder.GetSize());
-        for (auto r : remotePorts) {
-            r.second.port->send(Disseminate::FlatbufferTypes::Settings, message);
-        }
-    }
-
-    Disseminate::RemoteAdd::EventT addEvent;
-    // push over all remotes
-    for (auto r : remotePorts) {
-        r.second.port->send(Disseminate::FlatbufferTypes::RemoteClear);
-        const auto& self = r.second.uuid;
-        for (auto o : remotePorts) {
-            if (o.second.uuid != self) {
-                addEvent.uuid = o.second.uuid;
-
-                flatbuffers::FlatBufferBuilder builder;
-                auto buffer = Disseminate::RemoteAdd::CreateEvent(builder, &addEvent);
-                builder.Finish(buffer);
-
-                std::vector<uint8_t> message(builder.GetBufferPointer(),
-                                             builder.GetBufferPointer() + builder.GetSize());
-                r.second.port->send(Disseminate::FlatbufferTypes::RemoteAdd, message);
+    // a client gets specifics if it has a template or is in a group,
+    // without a template it keeps the global keys
+    const Configuration::Item* config = currentConfiguration();
+    const auto& peers = link.peers();
+    for (auto r = peers.cbegin(); r != peers.cend(); ++r) {
+        const QString group = config ? config->groups.value(r->client) : QString();
+        auto templ = temps.cend();
+        const auto chosen = chosenTemplates.find(r.key());
+        if (chosen != chosenTemplates.end() && !chosen->isEmpty())
+            templ = temps.find(*chosen);
+        if (templ == temps.cend() && group.isEmpty())
+            continue;
+        std::unique_ptr<Disseminate::Settings::ClientT> client(new Disseminate::Settings::ClientT);
+        client->uuid = r->uuid.toStdString();
+        client->group = group.toStdString();
+        if (templ != temps.cend()) {
+            client->type = templ->whitelist ? Disseminate::Settings::Type_WhiteList : Disseminate::Settings::Type_BlackList;
+            for (const auto& key : templ->keys) {
+                client->keys.push_back({ key.first, key.second });
             }
+            for (const auto& remap : templ->remaps) {
+                client->remaps.push_back({ { remap.first.first, remap.first.second },
+                                           { remap.second.first, remap.second.second } });
+            }
+        } else {
+            client->type = global.type;
+            client->keys = global.keys;
         }
+        global.specifics.push_back(std::move(client));
     }
 
+    // the controller sends it on along with everyone's identity and peers
+    FlatbufferEncoder encoder;
+    encoder.finish(Disseminate::Settings::CreateGlobal(encoder.builder(), &global));
+    link.pushSettings(encoder.data(), encoder.size());
 }
 
 void MainWindow::addKey()
@@ -280,7 +324,7 @@ void MainWindow::removeKey()
         delete item;
     }
 
-    saveConfig();
+    saveKeys();
 }
 
 void MainWindow::keyAdded(int64_t key, uint64_t mask)
@@ -291,7 +335,7 @@ void MainWindow::keyAdded(int64_t key, uint64_t mask)
         //broadcast::addKey(key, mask);
 #warning implement me
 
-        saveConfig();
+        saveKeys();
     }
 }
 
@@ -301,7 +345,7 @@ void MainWindow::whiteListChanged()
         //broadcast::setKeyType(broadcast::WhiteList);
 #warning implement me
 
-        saveConfig();
+        saveKeys();
     }
 }
 
@@ -311,7 +355,7 @@ void MainWindow::blackListChanged()
         //broadcast::setKeyType(broadcast::BlackList);
 #warning implement me
 
-        saveConfig();
+        saveKeys();
     }
 }
 
@@ -326,7 +370,7 @@ void MainWindow::templates()
 void MainWindow::templatesChanged(const Templates::Config& cfg)
 {
     temps = cfg;
-    saveConfig();
+    configStore.save(temps);
     applyConfig();
 }
 
@@ -341,45 +385,35 @@ void MainWindow::preferences()
 void MainWindow::preferencesChanged(const Preferences::Config& cfg)
 {
     prefs = cfg;
-    saveConfig();
+    configStore.save(prefs);
     applyConfig();
 }
 
 void MainWindow::loadConfig()
 {
-    QSettings settings("jhanssen", "Disseminate");
-    QVariant windows = settings.value("preferences/automaticWindows");
-    prefs.automaticWindows.clear();
-    QStringList list = windows.toStringList();
-    for (const auto& str : list) {
-        prefs.automaticWindows.append(str);
-    }
+    if (configStore.isEmpty())
+        configStore.migrate();
 
     //broadcast::clearKeys();
 #warning implement me
 
     ui->keyList->clear();
 
-    const QList<QVariant> keys = settings.value("keys").toList();
-    for (const auto& elem : keys) {
-        QVariantMap key = elem.toMap();
-        if (key.contains("key") && key.contains("mask")) {
-            const int64_t k = key["key"].toLongLong();
-            const uint64_t m = key["mask"].toULongLong();
-
-            if (k || m) {
-                const QString name = helpers::keyToQString(k, m);
-                if (!helpers::contains(ui->keyList, name)) {
-                    ui->keyList->addItem(new KeyItem(name, k, m));
-                    //broadcast::addKey(k, m);
+    ConfigStore::KeyList keys;
+    configStore.load(keys);
+    for (const auto& key : keys.keys) {
+        if (key.first || key.second) {
+            const QString name = helpers::keyToQString(key.first, key.second);
+            if (!helpers::contains(ui->keyList, name)) {
+                ui->keyList->addItem(new KeyItem(name, key.first, key.second));
+                //broadcast::addKey(k, m);
 #warning implement me
 
-                }
             }
         }
     }
 
-    if (settings.value("keyType").toString() != "blacklist") {
+    if (keys.whitelist) {
         ui->whitelistRadio->setChecked(true);
         ui->blacklistRadio->setChecked(false);
         //broadcast::setKeyType(broadcast::WhiteList);
@@ -394,168 +428,32 @@ void MainWindow::loadConfig()
     }
 
     temps.clear();
-    const QVariantMap templates = settings.value("templates").toMap();
-    // uhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhh
-    QVariantMap::const_iterator tempit = templates.begin();
-    const QVariantMap::const_iterator tempend = templates.end();
-    while (tempit != tempend) {
-        const QVariantMap ventry = tempit.value().toMap();
-        if (ventry.contains("whitelist") && ventry.contains("keys")) {
-            Templates::ConfigItem titem;
-            const QList<QVariant> vkeys = ventry["keys"].toList();
-            QVector<KeyCode>& tkeys = titem.keys;
-            for (const auto& k : vkeys) {
-                const QVariantMap km = k.toMap();
-                if (km.contains("key") && km.contains("mask")) {
-                    KeyCode tkey;
-                    tkey.first = km["key"].toLongLong();
-                    tkey.second = km["mask"].toULongLong();
-                    tkeys.append(tkey);
-                }
-            }
-            titem.whitelist = ventry["whitelist"].toBool();
-            temps[tempit.key()] = titem;
-        }
-        ++tempit;
-    }
+    configStore.load(temps);
 
     prefs.globalKey = { 0, 0 };
     prefs.globalMouse = { 0, 0 };
-    QVariantMap bindings = settings.value("bindings").toMap();
-    if (bindings.contains("keyboard") && bindings.contains("mouse")) {
-        QVariantMap v = bindings.value("keyboard").toMap();
-        if (v.contains("key") && v.contains("mask")) {
-            prefs.globalKey.first = v["key"].toLongLong();
-            prefs.globalKey.second = v["mask"].toULongLong();
-        }
-        v = bindings.value("mouse").toMap();
-        if (v.contains("key") && v.contains("mask")) {
-            prefs.globalMouse.first = v["key"].toLongLong();
-            prefs.globalMouse.second = v["mask"].toULongLong();
-        }
-    }
-
     prefs.exclusions.clear();
-    QList<QVariant> exclusions = settings.value("exclusions").toList();
-    for (const auto& exclusion : exclusions) {
-        const QVariantMap km = exclusion.toMap();
-        if (km.contains("key") && km.contains("mask")) {
-            KeyCode ekey;
-            ekey.first = km["key"].toLongLong();
-            ekey.second = km["mask"].toULongLong();
-            prefs.exclusions.append(ekey);
-        }
-    }
+    prefs.automaticWindows.clear();
+    configStore.load(prefs);
 
     ui->configuration->clear();
     configs.clear();
-    QList<QVariant> configurations = settings.value("configurations").toList();
-    for (const auto& config : configurations) {
-        const QVariantMap cm = config.toMap();
-        if (cm.contains("appPath") && cm.contains("name")) {
-            Configuration::Item item;
-            item.name = cm["name"].toString();
-            item.appPath = cm["appPath"].toString();
-            item.appIcon = cm["appIcon"].value<QPixmap>();
-            if (cm.contains("clients")) {
-                QList<QVariant> clients = cm["clients"].toList();
-                for (const auto& client : clients) {
-                    item.clients.append(client.toString());
-                }
-            }
-            configs.append(item);
-
-            ui->configuration->addItem(item.appIcon, item.name);
-        }
+    configStore.load(configs);
+    for (const auto& item : configs) {
+        ui->configuration->addItem(item.appIcon, item.name);
     }
 }
 
-void MainWindow::saveConfig()
+void MainWindow::saveKeys()
 {
-    QSettings settings("jhanssen", "Disseminate");
-    settings.setValue("preferences/automaticWindows", prefs.automaticWindows);
-
-    QList<QVariant> keys;
-    {
-        const int keyCount = ui->keyList->count();
-        for (int i = 0; i < keyCount; ++i) {
-            KeyItem* item = static_cast<KeyItem*>(ui->keyList->item(i));
-            QVariantMap k;
-            k["key"] = item->key;
-            k["mask"] = item->mask;
-            keys.append(k);
-        }
-    }
-    settings.setValue("keys", keys);
-
-    if (ui->whitelistRadio->isChecked()) {
-        settings.setValue("keyType", "whitelist");
-    } else {
-        settings.setValue("keyType", "blacklist");
-    }
-
-    QVariantMap templates;
-    {
-        Templates::Config::const_iterator it = temps.begin();
-        const Templates::Config::const_iterator end = temps.end();
-        while (it != end) {
-            QList<QVariant> tkeys;
-            for (const auto& k : it.value().keys) {
-                QVariantMap tkey;
-                tkey["key"] = k.first;
-                tkey["mask"] = k.second;
-                tkeys.append(tkey);
-            }
-            QVariantMap kentry;
-            kentry["whitelist"] = it.value().whitelist;
-            kentry["keys"] = tkeys;
-            templates[it.key()] = kentry;
-            ++it;
-        }
-    }
-    settings.setValue("templates", templates);
-
-    QVariantMap bindings;
-    {
-        QVariantMap key, mouse;
-        key["key"] = prefs.globalKey.first;
-        key["mask"] = prefs.globalKey.second;
-        mouse["key"] = prefs.globalMouse.first;
-        mouse["mask"] = prefs.globalMouse.second;
-        bindings["keyboard"] = key;
-        bindings["mouse"] = mouse;
-    }
-    settings.setValue("bindings", bindings);
-
-    QList<QVariant> exclusions;
-    {
-        const int exclusionCount = prefs.exclusions.size();
-        for (int i = 0; i < exclusionCount; ++i) {
-            QVariantMap exclusion;
-            exclusion["key"] = prefs.exclusions[i].first;
-            exclusion["mask"] = prefs.exclusions[i].second;
-            exclusions.append(exclusion);
-        }
-    }
-    settings.setValue("exclusions", exclusions);
-
-    QList<QVariant> configurations;
-    {
-        for (const auto& item : configs) {
-            QVariantMap cfg;
-            cfg["name"] = item.name;
-            cfg["appPath"] = item.appPath;
-            cfg["appIcon"] = item.appIcon;
-            QList<QVariant> clients;
-            for (const auto& client : item.clients) {
-                clients.append(client);
-            }
-            cfg["clients"] = clients;
-
-            configurations.append(cfg);
-        }
+    ConfigStore::KeyList keys;
+    keys.whitelist = ui->whitelistRadio->isChecked();
+    const int keyCount = ui->keyList->count();
+    for (int i = 0; i < keyCount; ++i) {
+        KeyItem* item = static_cast<KeyItem*>(ui->keyList->item(i));
+        keys.keys.append({ item->key, item->mask });
     }
-    settings.setValue("configurations", configurations);
+    configStore.save(keys);
 }
 
 void MainWindow::applyConfig()
@@ -566,14 +464,42 @@ void MainWindow::applyConfig()
 
 void MainWindow::reloadClients()
 {
-    ui->clientList->clear();
-    for (auto& remote : remotePorts) {
-        const auto& info = getInformation(remote.first);
-        remote.second.windowId = info.windowId;
-        if (!info.title.isEmpty()) {
-            QString text = info.title + " - " + QString::fromStdString(remote.second.client) + " (" + QString::number(info.windowId) + ")";
-            ui->clientList->addItem(new ClientItem(text, info.title, remote.first, info.windowId, info.icon));
+    const WindowInventory::Changes changes = windowInventory.refresh();
+    if (!changes.removed.empty() || !changes.changed.empty())
+        thumbnails.prune(windowInventory.windowIds());
+
+    // drop items for clients that went away or lost their window, and
+    // remember the rest so only what changed is touched below
+    QHash<int32_t, ClientItem*> items;
+    for (int i = ui->clientList->count() - 1; i >= 0; --i) {
+        ClientItem* item = static_cast<ClientItem*>(ui->clientList->item(i));
+        const ProcessInformation* info = windowInventory.find(item->wpid);
+        if (!link.peers().contains(item->wpid) || !info || info->title.isEmpty())
+            delete ui->clientList->takeItem(i);
+        else
+            items[item->wpid] = item;
+    }
+
+    const auto& peers = link.peers();
+    for (auto remote = peers.cbegin(); remote != peers.cend(); ++remote) {
+        const ProcessInformation* info = windowInventory.find(remote.key());
+        if (!info || info->title.isEmpty())
+            continue;
+        QString text = info->title + " - " + remote->client + " (" + QString::number(info->windowId) + ")";
+        if (remote->degraded)
+            text += " - not responding";
+        ClientItem* item = items.value(remote.key());
+        if (!item) {
+            item = new ClientItem(text, info->title, remote.key(), info->windowId, info->icon);
+            ui->clientList->addItem(item);
+        } else if (changes.affects(remote.key()) || item->text() != text) {
+            item->setText(text);
+            item->wname = info->title;
+            item->wid = info->windowId;
+            item->wicon = info->icon;
+            item->setIcon(info->icon);
         }
+        item->setForeground(remote->degraded ? QBrush(Qt::gray) : QBrush());
     }
 }
 
@@ -604,7 +530,7 @@ void MainWindow::clientDoubleClicked(QListWidgetItem* item)
     if (!item)
         return;
     ClientItem* witem = static_cast<ClientItem*>(item);
-    TemplateChooser chooser(this, chosenTemplates[witem->wpid], temps.keys(), witem->wpid, witem->wid);
+    TemplateChooser chooser(this, chosenTemplates[witem->wpid], temps.keys(), witem->wpid, witem->wid, &thumbnails);
     connect(&chooser, &TemplateChooser::chosen, this, &MainWindow::templateChosen);
 
     chooser.exec();
@@ -679,7 +605,7 @@ void MainWindow::removeConfiguration()
         ++cfg;
     }
 
-    saveConfig();
+    configStore.save(configs);
 }
 
 void MainWindow::configurationAdded(const Configuration::Item& item)
@@ -693,7 +619,7 @@ void MainWindow::configurationAdded(const Configuration::Item& item)
     configs.append(item);
     ui->configuration->addItem(item.appIcon, item.name);
 
-    saveConfig();
+    configStore.save(configs);
 }
 
 void MainWindow::configurationEdited(const Configuration::Item& item)
@@ -713,5 +639,5 @@ void MainWindow::configurationEdited(const Configuration::Item& item)
         }
     }
 
-    saveConfig();
+    configStore.save(configs);
 }
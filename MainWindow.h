@@ -23,10 +23,13 @@
 #include <QMap>
 #include <QVector>
 #include "Configuration.h"
-#include "ProcessInformation.h"
+#include "WindowInventory.h"
+#include "ThumbnailCapture.h"
+#include "ClientLauncher.h"
+#include "ConfigStore.h"
 #include "Preferences.h"
 #include "Templates.h"
-#include "MessagePort.h"
+#include "ControllerLink.h"
 #include <memory>
 
 namespace Ui {
@@ -34,7 +37,7 @@ class Disseminate;
 }
 
 class QListWidgetItem;
-class QProcess;
+class MetricsPanel;
 
 class MainWindow : public QMainWindow
 {
@@ -70,13 +73,14 @@ private slots:
     void templateChosen(int32_t psn, const QString& name);
 
     void pushSettings();
+    void requestScriptStats();
 
     void addConfiguration();
     void removeConfiguration();
     void editConfiguration();
 
 private:
-    void saveConfig();
+    void saveKeys();
     void loadConfig();
     void applyConfig();
 
@@ -84,6 +88,8 @@ private:
 
     void terminate(const QString client);
 
+    void scriptStatsReceived(const QByteArray& msg);
+
     const Configuration::Item* currentConfiguration();
 
 private:
@@ -93,20 +99,18 @@ private:
     Preferences::Config prefs;
     Templates::Config temps;
     QVector<Configuration::Item> configs;
+    ConfigStore configStore;
 
     QMap<int32_t, QString> chosenTemplates;
 
-    MessagePortLocal messagePort;
+    ControllerLink link;
+
+    WindowInventory windowInventory;
+    ThumbnailCapture thumbnails;
 
-    struct RemotePort
-    {
-        std::string uuid, client;
-        uint64_t windowId;
-        std::shared_ptr<MessagePortRemote> port;
-    };
-    std::map<int32_t, RemotePort> remotePorts;
+    ClientLauncher launcher;
 
-    QMap<QString, QProcess*> running;
+    MetricsPanel* metricsPanel;
 };
 
 #endif // DISSEMINATE_H
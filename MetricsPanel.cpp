@@ -0,0 +1,106 @@
+/*
+  Disseminate, keyboard broadcaster
+  Copyright (C) 2016  Jan Erik Hanssen
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MetricsPanel.h"
+#include "MetricsExporter.h"
+#include "MetricsReport.h"
+#include "ui_MetricsPanel.h"
+#include <QSet>
+#include <QTreeWidgetItem>
+
+MetricsPanel::MetricsPanel(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::MetricsPanel)
+{
+    ui->setupUi(this);
+    clock.start();
+    ui->exportLabel->setText("Exported to " + QString::fromStdString(MetricsExporter::defaultPath()));
+}
+
+MetricsPanel::~MetricsPanel()
+{
+    delete ui;
+}
+
+QTreeWidgetItem* MetricsPanel::sourceItem(const QString& name)
+{
+    const int count = ui->metricsTree->topLevelItemCount();
+    for (int i = 0; i < count; ++i) {
+        QTreeWidgetItem* item = ui->metricsTree->topLevelItem(i);
+        if (item->text(0) == name)
+            return item;
+    }
+    QTreeWidgetItem* item = new QTreeWidgetItem(ui->metricsTree, QStringList() << name);
+    item->setExpanded(true);
+    return item;
+}
+
+void MetricsPanel::setReport(const QByteArray& data)
+{
+    std::vector<Metrics::Source> sources;
+    if (!decodeMetrics(reinterpret_cast<const uint8_t*>(data.constData()), data.size(), sources))
+        return;
+
+    enum { StaleRate = 10000 };
+    const qint64 now = clock.elapsed();
+
+    // items are updated in place so expansion and selection survive
+    QSet<QString> seen;
+    QHash<QString, Counter> current;
+    for (const Metrics::Source& source : sources) {
+        const QString sourceName = QString::fromStdString(source.name);
+        seen.insert(sourceName);
+        QTreeWidgetItem* parent = sourceItem(sourceName);
+
+        QHash<QString, QTreeWidgetItem*> children;
+        for (int i = 0; i < parent->childCount(); ++i)
+            children[parent->child(i)->text(0)] = parent->child(i);
+
+        for (const Metrics::Sample& sample : source.samples) {
+            const QString name = QString::fromStdString(sample.name);
+            QTreeWidgetItem* item = children.take(name);
+            if (!item)
+                item = new QTreeWidgetItem(parent, QStringList() << name);
+            item->setText(1, QString::number(sample.value));
+
+            if (sample.kind != Metrics::Counter)
+                continue;
+            const QString key = sourceName + '\n' + name;
+            auto prev = counters.constFind(key);
+            if (prev == counters.cend() || sample.value < prev->value) {
+                current[key] = { sample.value, now };
+            } else if (sample.value != prev->value) {
+                const double seconds = (now - prev->changed) / 1000.;
+                if (seconds > 0)
+                    item->setText(2, QString("%1/s").arg((sample.value - prev->value) / seconds, 0, 'f', 1));
+                current[key] = { sample.value, now };
+            } else {
+                if (now - prev->changed > StaleRate)
+                    item->setText(2, "0.0/s");
+                current[key] = *prev;
+            }
+        }
+        qDeleteAll(children);
+    }
+    counters.swap(current);
+
+    for (int i = ui->metricsTree->topLevelItemCount() - 1; i >= 0; --i) {
+        if (!seen.contains(ui->metricsTree->topLevelItem(i)->text(0)))
+            delete ui->metricsTree->takeTopLevelItem(i);
+    }
+}
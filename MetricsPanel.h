@@ -0,0 +1,64 @@
+/*
+  Disseminate, keyboard broadcaster
+  Copyright (C) 2016  Jan Erik Hanssen
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef METRICSPANEL_H
+#define METRICSPANEL_H
+
+#include <QDialog>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+
+namespace Ui {
+class MetricsPanel;
+}
+
+class QTreeWidgetItem;
+
+// Shows the metrics the controller sends every couple of seconds, one
+// branch for the controller and one for each client that reported.
+// Clients report less often than the controller sends, so counter rates
+// are taken between changes rather than between reports.
+class MetricsPanel : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsPanel(QWidget *parent = 0);
+    ~MetricsPanel();
+
+public slots:
+    // a Metrics.Report
+    void setReport(const QByteArray& data);
+
+private:
+    QTreeWidgetItem* sourceItem(const QString& name);
+
+    Ui::MetricsPanel *ui;
+    struct Counter
+    {
+        quint64 value;
+        qint64 changed; // clock.elapsed() when value last changed
+    };
+
+    QElapsedTimer clock;
+    // keyed on source and sample name
+    QHash<QString, Counter> counters;
+};
+
+#endif // METRICSPANEL_H
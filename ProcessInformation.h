@@ -29,7 +29,4 @@ struct ProcessInformation
     uint64_t windowId;
 };
 
-ProcessInformation getInformation(pid_t pid);
-QPixmap getScreenshot(pid_t pid);
-
 #endif
@@ -17,6 +17,8 @@
 */
 
 #include "ProcessInformation.h"
+#include "WindowInventory.h"
+#include "IconCache.h"
 #include "CocoaUtils.h"
 #import <Cocoa/Cocoa.h>
 #include <QtMac>
@@ -28,14 +30,7 @@ static QString toQString(NSString* str)
 
 struct WindowData
 {
-    pid_t pid;
-    struct Entry
-    {
-        CGWindowID window;
-        QPixmap icon;
-        QString name;
-    };
-    std::vector<Entry> windows;
+    std::vector<WindowRecord> windows;
 };
 
 void WindowListApplierFunction(const void *inputDictionary, void *context)
@@ -54,37 +49,24 @@ void WindowListApplierFunction(const void *inputDictionary, void *context)
         if (layer != 0)
             return;
 
-        auto pid = [entry[(id)kCGWindowOwnerPID] integerValue];
-        if (pid != data->pid)
-            return;
-
-        WindowData::Entry info;
+        WindowRecord info;
+        info.pid = [entry[(id)kCGWindowOwnerPID] integerValue];
 
         // Grab the application name, but since it's optional we need to check before we can use it.
         NSString *applicationName = entry[(id)kCGWindowOwnerName];
         if(applicationName != NULL)
         {
-            info.name = toQString(applicationName);
+            info.owner = toQString(applicationName);
         }
         else
         {
             // The application name was not provided, so we use a fake application name to designate this.
             // PID is required so we assume it's present.
             NSString *nameAndPID = [NSString stringWithFormat:@"((unknown)) (%@)", entry[(id)kCGWindowOwnerPID]];
-            info.name = toQString(nameAndPID);
+            info.owner = toQString(nameAndPID);
             [nameAndPID release];
         }
-        auto windowId = [entry[(id)kCGWindowNumber] integerValue];
-        info.window = windowId;
-
-        // Grab the Window icon.
-        NSRunningApplication* app = [NSRunningApplication runningApplicationWithProcessIdentifier:pid];
-        NSImage* icon = [app icon];
-        if (icon) {
-            NSRect iconRect = NSMakeRect(0, 0, icon.size.width, icon.size.height);
-            CGImageRef cgIcon = [icon CGImageForProposedRect:&iconRect context:NULL hints:nil];
-            info.icon = QtMac::fromCGImageRef(cgIcon);
-        }
+        info.windowId = [entry[(id)kCGWindowNumber] integerValue];
         data->windows.push_back(info);
 
         /*
@@ -120,40 +102,35 @@ void WindowListApplierFunction(const void *inputDictionary, void *context)
     }
 }
 
-static void windowsForPid(pid_t pid, WindowData* windowData)
+static void allWindows(WindowData* windowData)
 {
     CGWindowListOption listOptions;
     listOptions = kCGWindowListOptionAll | kCGWindowListOptionOnScreenOnly | kCGWindowListExcludeDesktopElements;
 
     CFArrayRef windowList = CGWindowListCopyWindowInfo(listOptions, kCGNullWindowID);
 
-    // Copy the returned list, further pruned, to another list. This also adds some bookkeeping
-    // information to the list as well as
-    windowData->pid = pid;
-
+    // Copy the returned list, further pruned, to another list
     CFArrayApplyFunction(windowList, CFRangeMake(0, CFArrayGetCount(windowList)), &WindowListApplierFunction, (__bridge void *)windowData);
     CFRelease(windowList);
 }
 
-QPixmap getScreenshot(pid_t pid)
+class WindowServerProvider : public WindowProvider
 {
-    WindowData data;
-    windowsForPid(pid, &data);
-
-    if (data.windows.empty())
-        return QPixmap();
-    auto windowId = data.windows[0].window;
-    CGImageRef windowImage = CGWindowListCreateImage(CGRectNull, kCGWindowListOptionIncludingWindow, windowId, kCGWindowImageDefault | kCGWindowImageShouldBeOpaque);
-    return QtMac::fromCGImageRef(windowImage);
-}
+public:
+    std::vector<WindowRecord> windows() override
+    {
+        WindowData data;
+        allWindows(&data);
+        return std::move(data.windows);
+    }
 
-ProcessInformation getInformation(pid_t pid)
-{
-    WindowData data;
-    windowsForPid(pid, &data);
+    QPixmap icon(pid_t pid) override
+    {
+        return IconCache::instance()->forApplication(pid);
+    }
+};
 
-    if (data.windows.empty())
-        return ProcessInformation();
-    ProcessInformation info = { data.windows[0].icon, data.windows[0].name, data.windows[0].window };
-    return info;
+std::unique_ptr<WindowProvider> createWindowServerProvider()
+{
+    return std::make_unique<WindowServerProvider>();
 }
@@ -0,0 +1,223 @@
+#include "Coroutines.h"
+#include "EventBindings.h"
+#include "Host.h"
+#include <stdio.h>
+
+static char sSleepTag;
+static char sNextKeyTag;
+
+Coroutines::Coroutines(Host* host)
+    : mHost(host), mMain(0), mTimerDue(0), mOrder(0), mHandlerBusy(false)
+{
+    mHandler.thread = 0;
+    mHandler.ref = LUA_NOREF;
+}
+
+Coroutines::~Coroutines()
+{
+    if (mTimerDue)
+        mTimer->stop();
+    if (!mMain)
+        return;
+    while (!mSleepers.empty()) {
+        release(mSleepers.top().waiter);
+        mSleepers.pop();
+    }
+    for (const auto& waiter : mKeyWaiters) {
+        release(waiter);
+    }
+    if (mHandler.thread)
+        release(mHandler);
+}
+
+void Coroutines::registerBindings(lua_State* l)
+{
+    lua_rawgeti(l, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+    mMain = lua_tothread(l, -1);
+    lua_pop(l, 1);
+
+    const luaL_Reg functions[] = {
+        { "async", async },
+        { "await", await },
+        { "sleep", sleep },
+        { "nextKey", nextKey },
+        { 0, 0 }
+    };
+    lua_pushglobaltable(l);
+    lua_pushlightuserdata(l, this);
+    luaL_setfuncs(l, functions, 1);
+    lua_pop(l, 1);
+}
+
+int Coroutines::async(lua_State* l)
+{
+    Coroutines* coroutines = static_cast<Coroutines*>(lua_touserdata(l, lua_upvalueindex(1)));
+    luaL_checktype(l, 1, LUA_TFUNCTION);
+    const int nargs = lua_gettop(l) - 1;
+
+    const Waiter waiter = coroutines->newThread(l);
+    lua_xmove(l, waiter.thread, nargs + 1);
+
+    coroutines->resume(l, waiter, nargs);
+    return 0;
+}
+
+Coroutines::Waiter Coroutines::newThread(lua_State* l)
+{
+    // shares the hook and extra space of l, see setResumeScope for budgets
+    lua_State* thread = lua_newthread(l);
+    // the registry keeps the thread alive for as long as it's suspended
+    const Waiter waiter = { thread, luaL_ref(l, LUA_REGISTRYINDEX) };
+    return waiter;
+}
+
+bool Coroutines::call(lua_State* l, int nargs)
+{
+    const bool cached = !mHandlerBusy;
+    if (cached && !mHandler.thread)
+        mHandler = newThread(l);
+    const Waiter waiter = cached ? mHandler : newThread(l);
+    lua_State* thread = waiter.thread;
+    lua_xmove(l, thread, nargs + 1);
+
+    if (cached)
+        mHandlerBusy = true;
+    const int status = lua_resume(thread, l, nargs);
+    if (cached)
+        mHandlerBusy = false;
+
+    if (status == LUA_OK) {
+        const bool ret = lua_gettop(thread) > 0 && lua_toboolean(thread, 1);
+        lua_settop(thread, 0);
+        if (!cached)
+            release(waiter);
+        return ret;
+    }
+    // a suspended or failed thread can't take the next handler
+    if (cached)
+        mHandler.thread = 0;
+    if (status == LUA_YIELD) {
+        park(waiter);
+    } else {
+        printf("error: %s\n", lua_tostring(thread, -1));
+        release(waiter);
+    }
+    return true;
+}
+
+int Coroutines::await(lua_State* l)
+{
+    return lua_yield(l, lua_gettop(l));
+}
+
+int Coroutines::sleep(lua_State* l)
+{
+    const lua_Integer ms = luaL_checkinteger(l, 1);
+    lua_pushlightuserdata(l, &sSleepTag);
+    lua_pushinteger(l, ms > 0 ? ms : 0);
+    return 2;
+}
+
+int Coroutines::nextKey(lua_State* l)
+{
+    lua_pushlightuserdata(l, &sNextKeyTag);
+    return 1;
+}
+
+void Coroutines::resume(lua_State* from, const Waiter& waiter, int nargs)
+{
+    lua_State* thread = waiter.thread;
+    const int status = lua_resume(thread, from, nargs);
+    if (status != LUA_YIELD) {
+        if (status != LUA_OK)
+            printf("error: %s\n", lua_tostring(thread, -1));
+        release(waiter);
+        return;
+    }
+    park(waiter);
+}
+
+void Coroutines::wake(const Waiter& waiter, int nargs)
+{
+    if (mResumeScope)
+        mResumeScope(true);
+    resume(0, waiter, nargs);
+    if (mResumeScope)
+        mResumeScope(false);
+}
+
+void Coroutines::park(const Waiter& waiter)
+{
+    lua_State* thread = waiter.thread;
+    // the stack now holds whatever was passed to await()
+    const void* tag = lua_gettop(thread) > 0 ? lua_touserdata(thread, 1) : 0;
+    if (tag == &sSleepTag) {
+        const uint64_t ms = lua_tointeger(thread, 2);
+        lua_settop(thread, 0);
+        mSleepers.push({ mHost->now() + ms * 1000000, mOrder++, waiter });
+        schedule();
+    } else if (tag == &sNextKeyTag) {
+        lua_settop(thread, 0);
+        mKeyWaiters.push_back(waiter);
+    } else {
+        printf("error: await() needs the result of sleep() or nextKey()\n");
+        release(waiter);
+    }
+}
+
+void Coroutines::release(const Waiter& waiter)
+{
+    luaL_unref(mMain, LUA_REGISTRYINDEX, waiter.ref);
+}
+
+void Coroutines::schedule()
+{
+    if (mSleepers.empty())
+        return;
+    const uint64_t due = mSleepers.top().due;
+    if (mTimerDue && mTimerDue <= due)
+        return;
+
+    if (!mTimer) {
+        mTimer = mHost->makeTimer();
+        mTimer->onTimeout([this]() { fire(); });
+    } else if (mTimerDue) {
+        mTimer->stop();
+    }
+
+    const uint64_t now = mHost->now();
+    const uint32_t ms = due > now ? (due - now + 999999) / 1000000 : 0;
+    mTimer->restart(ms);
+    mTimerDue = due;
+}
+
+void Coroutines::fire()
+{
+    mTimerDue = 0;
+    const uint64_t now = mHost->now();
+    while (!mSleepers.empty() && mSleepers.top().due <= now) {
+        const Waiter waiter = mSleepers.top().waiter;
+        mSleepers.pop();
+        wake(waiter, 0);
+    }
+    schedule();
+}
+
+void Coroutines::keyEvent(int type, const KeyEvent& event)
+{
+    if (mKeyWaiters.empty())
+        return;
+    // coroutines that wait again from here get the next key, not this one
+    std::vector<Waiter> waiters;
+    waiters.swap(mKeyWaiters);
+    for (const auto& waiter : waiters) {
+        lua_pushinteger(waiter.thread, type);
+        EventBindings::push(waiter.thread, event);
+        wake(waiter, 2);
+    }
+    if (mKeyWaiters.empty()) {
+        // hang on to the capacity
+        waiters.clear();
+        mKeyWaiters.swap(waiters);
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef COROUTINES_H
+#define COROUTINES_H
+
+#include <lua.hpp>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
+
+class Host;
+class EventLoopTimer;
+class KeyEvent;
+
+// Lets scripts write sequential code on top of lua coroutines:
+//
+//   async(function()
+//       await(sleep(100))
+//       local type, ke = await(nextKey())
+//   end)
+//
+// Event handlers run as coroutines too, so they can await() directly. A
+// handler that awaits has accepted its event, the rest of it runs later.
+//
+// sleep() and nextKey() only return a tag, await() yields it back to us.
+// Sleeping coroutines go in a heap driven by a single EventLoopTimer and
+// key waiters in a list that the key dispatch drains, so waiting doesn't
+// create a closure or a timer per call.
+class Coroutines
+{
+public:
+    Coroutines(Host* host);
+    ~Coroutines();
+
+    // registers async, await, sleep and nextKey as globals
+    void registerBindings(lua_State* l);
+
+    // calls the function below nargs arguments on top of l's stack on a
+    // coroutine and pops them. Returns what it returned as a boolean, true
+    // if it awaited or raised an error
+    bool call(lua_State* l, int nargs);
+
+    // called around every resume that doesn't happen from within running
+    // lua, from a sleep timer or a key, so the engine can put it under
+    // its instruction budget
+    typedef std::function<void(bool resuming)> ResumeScope;
+    void setResumeScope(const ResumeScope& scope) { mResumeScope = scope; }
+
+    // resumes everything waiting for a key, call before the key handlers
+    void keyEvent(int type, const KeyEvent& event);
+
+    size_t sleeping() const { return mSleepers.size(); }
+    size_t waiting() const { return mKeyWaiters.size(); }
+
+private:
+    Coroutines(const Coroutines&) = delete;
+    Coroutines& operator=(const Coroutines&) = delete;
+
+    struct Waiter
+    {
+        lua_State* thread;
+        int ref;
+    };
+    struct Sleeper
+    {
+        uint64_t due; // nanoseconds
+        uint64_t order; // keeps coroutines sleeping equally long in order
+        Waiter waiter;
+
+        bool operator>(const Sleeper& other) const
+        {
+            return due > other.due || (due == other.due && order > other.order);
+        }
+    };
+
+    static int async(lua_State* l);
+    static int await(lua_State* l);
+    static int sleep(lua_State* l);
+    static int nextKey(lua_State* l);
+
+    Waiter newThread(lua_State* l);
+    // resumes with nargs values on the thread's stack and files the
+    // coroutine according to what it yielded, or releases it when done
+    void resume(lua_State* from, const Waiter& waiter, int nargs);
+    // resume() within the ResumeScope
+    void wake(const Waiter& waiter, int nargs);
+    // files a coroutine that yielded by what it's waiting for
+    void park(const Waiter& waiter);
+    void release(const Waiter& waiter);
+    void schedule();
+    void fire();
+
+    Host* mHost;
+    lua_State* mMain;
+    std::shared_ptr<EventLoopTimer> mTimer;
+    uint64_t mTimerDue; // 0 if the timer isn't running
+    uint64_t mOrder;
+    std::priority_queue<Sleeper, std::vector<Sleeper>, std::greater<Sleeper> > mSleepers;
+    std::vector<Waiter> mKeyWaiters;
+    // handlers run here and it's kept until one awaits or fails. Busy
+    // while a handler runs, one that dispatches again gets a new thread
+    Waiter mHandler;
+    bool mHandlerBusy;
+    ResumeScope mResumeScope;
+};
+
+#endif
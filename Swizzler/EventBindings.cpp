@@ -0,0 +1,412 @@
+#include "EventBindings.h"
+#include "Events.h"
+#include <new>
+#include <string>
+
+static char sMouseEventKey;
+static char sKeyEventKey;
+
+template<typename T>
+struct EventMeta;
+
+template<>
+struct EventMeta<MouseEvent>
+{
+    static void* key() { return &sMouseEventKey; }
+    static const char* name() { return "MouseEvent"; }
+};
+
+template<>
+struct EventMeta<KeyEvent>
+{
+    static void* key() { return &sKeyEventKey; }
+    static const char* name() { return "KeyEvent"; }
+};
+
+template<typename T>
+static inline T* toEvent(lua_State* l, int idx)
+{
+    void* ud = lua_touserdata(l, idx);
+    if (!ud || !lua_getmetatable(l, idx))
+        return 0;
+    lua_rawgetp(l, LUA_REGISTRYINDEX, EventMeta<T>::key());
+    const bool match = lua_rawequal(l, -1, -2);
+    lua_pop(l, 2);
+    return match ? static_cast<T*>(ud) : 0;
+}
+
+template<typename T>
+static inline T& checkEvent(lua_State* l, int idx)
+{
+    T* event = toEvent<T>(l, idx);
+    if (!event) {
+        const char* msg = lua_pushfstring(l, "%s expected, got %s", EventMeta<T>::name(), luaL_typename(l, idx));
+        luaL_argerror(l, idx, msg);
+    }
+    return *event;
+}
+
+template<typename T>
+static inline void pushEvent(lua_State* l, const T& event)
+{
+    void* ud = lua_newuserdata(l, sizeof(T));
+    new (ud) T(event);
+    lua_rawgetp(l, LUA_REGISTRYINDEX, EventMeta<T>::key());
+    lua_setmetatable(l, -2);
+}
+
+template<typename T>
+static int destroyEvent(lua_State* l)
+{
+    static_cast<T*>(lua_touserdata(l, 1))->~T();
+    return 0;
+}
+
+static inline void pushString(lua_State* l, const std::string& str)
+{
+    lua_pushlstring(l, str.c_str(), str.size());
+}
+
+// MouseEvent
+
+static int mouseNew(lua_State* l)
+{
+    const int type = luaL_checkinteger(l, 1);
+    const int button = luaL_checkinteger(l, 2);
+    const double x = luaL_checknumber(l, 3);
+    const double y = luaL_checknumber(l, 4);
+    pushEvent(l, MouseEvent(type, button, x, y));
+    return 1;
+}
+
+static int mouseType(lua_State* l)
+{
+    lua_pushinteger(l, checkEvent<MouseEvent>(l, 1).type());
+    return 1;
+}
+
+static int mouseSetType(lua_State* l)
+{
+    checkEvent<MouseEvent>(l, 1).setType(luaL_checkinteger(l, 2));
+    return 0;
+}
+
+static int mouseButton(lua_State* l)
+{
+    lua_pushinteger(l, checkEvent<MouseEvent>(l, 1).button());
+    return 1;
+}
+
+static int mouseSetButton(lua_State* l)
+{
+    checkEvent<MouseEvent>(l, 1).setButton(luaL_checkinteger(l, 2));
+    return 0;
+}
+
+static int mouseX(lua_State* l)
+{
+    lua_pushnumber(l, checkEvent<MouseEvent>(l, 1).x());
+    return 1;
+}
+
+static int mouseSetX(lua_State* l)
+{
+    checkEvent<MouseEvent>(l, 1).setX(luaL_checknumber(l, 2));
+    return 0;
+}
+
+static int mouseY(lua_State* l)
+{
+    lua_pushnumber(l, checkEvent<MouseEvent>(l, 1).y());
+    return 1;
+}
+
+static int mouseSetY(lua_State* l)
+{
+    checkEvent<MouseEvent>(l, 1).setY(luaL_checknumber(l, 2));
+    return 0;
+}
+
+static int mouseModifiers(lua_State* l)
+{
+    lua_pushinteger(l, checkEvent<MouseEvent>(l, 1).modifiers());
+    return 1;
+}
+
+static int mouseSetModifiers(lua_State* l)
+{
+    checkEvent<MouseEvent>(l, 1).setModifiers(luaL_checkinteger(l, 2));
+    return 0;
+}
+
+static int mouseClickCount(lua_State* l)
+{
+    lua_pushinteger(l, checkEvent<MouseEvent>(l, 1).clickCount());
+    return 1;
+}
+
+static int mouseSetClickCount(lua_State* l)
+{
+    checkEvent<MouseEvent>(l, 1).setClickCount(luaL_checkinteger(l, 2));
+    return 0;
+}
+
+static int mousePressure(lua_State* l)
+{
+    lua_pushnumber(l, checkEvent<MouseEvent>(l, 1).pressure());
+    return 1;
+}
+
+static int mouseSetPressure(lua_State* l)
+{
+    checkEvent<MouseEvent>(l, 1).setPressure(luaL_checknumber(l, 2));
+    return 0;
+}
+
+static int mouseDeltaX(lua_State* l)
+{
+    lua_pushnumber(l, checkEvent<MouseEvent>(l, 1).deltaX());
+    return 1;
+}
+
+static int mouseSetDeltaX(lua_State* l)
+{
+    checkEvent<MouseEvent>(l, 1).setDeltaX(luaL_checknumber(l, 2));
+    return 0;
+}
+
+static int mouseDeltaY(lua_State* l)
+{
+    lua_pushnumber(l, checkEvent<MouseEvent>(l, 1).deltaY());
+    return 1;
+}
+
+static int mouseSetDeltaY(lua_State* l)
+{
+    checkEvent<MouseEvent>(l, 1).setDeltaY(luaL_checknumber(l, 2));
+    return 0;
+}
+
+static int mouseFromUuid(lua_State* l)
+{
+    pushString(l, checkEvent<MouseEvent>(l, 1).fromUuid());
+    return 1;
+}
+
+static int mouseClone(lua_State* l)
+{
+    pushEvent(l, checkEvent<MouseEvent>(l, 1).clone());
+    return 1;
+}
+
+// KeyEvent
+
+static int keyNew(lua_State* l)
+{
+    const int type = luaL_checkinteger(l, 1);
+    const int keyCode = luaL_checkinteger(l, 2);
+    const double x = luaL_checknumber(l, 3);
+    const double y = luaL_checknumber(l, 4);
+    pushEvent(l, KeyEvent(type, keyCode, x, y));
+    return 1;
+}
+
+static int keyType(lua_State* l)
+{
+    lua_pushinteger(l, checkEvent<KeyEvent>(l, 1).type());
+    return 1;
+}
+
+static int keySetType(lua_State* l)
+{
+    checkEvent<KeyEvent>(l, 1).setType(luaL_checkinteger(l, 2));
+    return 0;
+}
+
+static int keyKeyCode(lua_State* l)
+{
+    lua_pushinteger(l, checkEvent<KeyEvent>(l, 1).keyCode());
+    return 1;
+}
+
+static int keySetKeyCode(lua_State* l)
+{
+    KeyEvent& event = checkEvent<KeyEvent>(l, 1);
+    const lua_Integer keyCode = luaL_checkinteger(l, 2);
+    // detach from any other copies before writing to the flatbuffer
+    event = event.clone();
+    event.flat()->keyCode = keyCode;
+    return 0;
+}
+
+static int keyX(lua_State* l)
+{
+    lua_pushnumber(l, checkEvent<KeyEvent>(l, 1).x());
+    return 1;
+}
+
+static int keySetX(lua_State* l)
+{
+    checkEvent<KeyEvent>(l, 1).setX(luaL_checknumber(l, 2));
+    return 0;
+}
+
+static int keyY(lua_State* l)
+{
+    lua_pushnumber(l, checkEvent<KeyEvent>(l, 1).y());
+    return 1;
+}
+
+static int keySetY(lua_State* l)
+{
+    checkEvent<KeyEvent>(l, 1).setY(luaL_checknumber(l, 2));
+    return 0;
+}
+
+static int keyModifiers(lua_State* l)
+{
+    lua_pushinteger(l, checkEvent<KeyEvent>(l, 1).modifiers());
+    return 1;
+}
+
+static int keySetModifiers(lua_State* l)
+{
+    checkEvent<KeyEvent>(l, 1).setModifiers(luaL_checkinteger(l, 2));
+    return 0;
+}
+
+static int keyText(lua_State* l)
+{
+    pushString(l, checkEvent<KeyEvent>(l, 1).text());
+    return 1;
+}
+
+static int keySetText(lua_State* l)
+{
+    KeyEvent& event = checkEvent<KeyEvent>(l, 1);
+    size_t len;
+    const char* text = luaL_checklstring(l, 2, &len);
+    event.setText(std::string(text, len));
+    return 0;
+}
+
+static int keyRepeat(lua_State* l)
+{
+    lua_pushboolean(l, checkEvent<KeyEvent>(l, 1).repeat());
+    return 1;
+}
+
+static int keySetRepeat(lua_State* l)
+{
+    checkEvent<KeyEvent>(l, 1).setRepeat(lua_toboolean(l, 2) != 0);
+    return 0;
+}
+
+static int keyFromUuid(lua_State* l)
+{
+    pushString(l, checkEvent<KeyEvent>(l, 1).fromUuid());
+    return 1;
+}
+
+static int keyClone(lua_State* l)
+{
+    pushEvent(l, checkEvent<KeyEvent>(l, 1).clone());
+    return 1;
+}
+
+template<typename T>
+static void registerType(lua_State* l, const luaL_Reg* methods, lua_CFunction constructor)
+{
+    // metatable doubles as the method table
+    lua_newtable(l);
+    luaL_setfuncs(l, methods, 0);
+    lua_pushvalue(l, -1);
+    lua_setfield(l, -2, "__index");
+    lua_pushcfunction(l, destroyEvent<T>);
+    lua_setfield(l, -2, "__gc");
+    lua_rawsetp(l, LUA_REGISTRYINDEX, EventMeta<T>::key());
+
+    lua_newtable(l);
+    lua_pushcfunction(l, constructor);
+    lua_setfield(l, -2, "new");
+    lua_setglobal(l, EventMeta<T>::name());
+}
+
+void EventBindings::registerTypes(lua_State* l)
+{
+    const luaL_Reg mouse[] = {
+        { "type", mouseType },
+        { "set_type", mouseSetType },
+        { "button", mouseButton },
+        { "set_button", mouseSetButton },
+        { "x", mouseX },
+        { "set_x", mouseSetX },
+        { "y", mouseY },
+        { "set_y", mouseSetY },
+        { "modifiers", mouseModifiers },
+        { "set_modifiers", mouseSetModifiers },
+        { "clickCount", mouseClickCount },
+        { "set_clickCount", mouseSetClickCount },
+        { "pressure", mousePressure },
+        { "set_pressure", mouseSetPressure },
+        { "deltax", mouseDeltaX },
+        { "set_deltaX", mouseSetDeltaX },
+        { "deltay", mouseDeltaY },
+        { "set_deltaY", mouseSetDeltaY },
+        { "fromUuid", mouseFromUuid },
+        { "clone", mouseClone },
+        { 0, 0 }
+    };
+    registerType<MouseEvent>(l, mouse, mouseNew);
+
+    const luaL_Reg key[] = {
+        { "type", keyType },
+        { "set_type", keySetType },
+        { "keycode", keyKeyCode },
+        { "set_keycode", keySetKeyCode },
+        { "x", keyX },
+        { "set_x", keySetX },
+        { "y", keyY },
+        { "set_y", keySetY },
+        { "modifiers", keyModifiers },
+        { "set_modifiers", keySetModifiers },
+        { "text", keyText },
+        { "set_text", keySetText },
+        { "repeat", keyRepeat },
+        { "set_repeat", keySetRepeat },
+        { "fromUuid", keyFromUuid },
+        { "clone", keyClone },
+        { 0, 0 }
+    };
+    registerType<KeyEvent>(l, key, keyNew);
+}
+
+void EventBindings::push(lua_State* l, const MouseEvent& event)
+{
+    pushEvent(l, event);
+}
+
+void EventBindings::push(lua_State* l, const KeyEvent& event)
+{
+    pushEvent(l, event);
+}
+
+MouseEvent* EventBindings::toMouseEvent(lua_State* l, int idx)
+{
+    return toEvent<MouseEvent>(l, idx);
+}
+
+KeyEvent* EventBindings::toKeyEvent(lua_State* l, int idx)
+{
+    return toEvent<KeyEvent>(l, idx);
+}
+
+MouseEvent& EventBindings::checkMouseEvent(lua_State* l, int idx)
+{
+    return checkEvent<MouseEvent>(l, idx);
+}
+
+KeyEvent& EventBindings::checkKeyEvent(lua_State* l, int idx)
+{
+    return checkEvent<KeyEvent>(l, idx);
+}
@@ -0,0 +1,28 @@
+#ifndef EVENTBINDINGS_H
+#define EVENTBINDINGS_H
+
+#include <lua.hpp>
+
+class MouseEvent;
+class KeyEvent;
+
+// MouseEvent and KeyEvent as plain userdata with hand written accessors.
+// The userdata holds the event object itself and the metatables live in
+// the registry under light userdata keys, so reading a field is a single
+// C call without any marshaling or heap traffic.
+namespace EventBindings {
+void registerTypes(lua_State* l);
+
+void push(lua_State* l, const MouseEvent& event);
+void push(lua_State* l, const KeyEvent& event);
+
+// returns 0 if the value at idx isn't of the requested type
+MouseEvent* toMouseEvent(lua_State* l, int idx);
+KeyEvent* toKeyEvent(lua_State* l, int idx);
+
+// raises a lua error if the value at idx isn't of the requested type
+MouseEvent& checkMouseEvent(lua_State* l, int idx);
+KeyEvent& checkKeyEvent(lua_State* l, int idx);
+}
+
+#endif
@@ -5,52 +5,9 @@
 #include <memory>
 #include <map>
 #include <vector>
-#include <AppKit/NSEvent.h>
-#include "Events.h"
+#include "Host.h"
 
-class EventLoop;
-
-class EventLoopEvent
-{
-public:
-    EventLoopEvent(const KeyEvent& event);
-    EventLoopEvent(const MouseEvent& event);
-    EventLoopEvent(NSEvent* event);
-    ~EventLoopEvent();
-
-    KeyEvent kevt;
-    MouseEvent mevt;
-    NSEvent* nsevt;
-};
-
-class EventLoopTimer : public std::enable_shared_from_this<EventLoopTimer>
-{
-public:
-    enum Type { Timeout, Interval };
-
-    void start(uint32_t timeout, Type type = Timeout);
-    bool stop();
-
-    void onTimeout(const std::function<void()>& func);
-
-    void operator()() { callback(); }
-
-private:
-    EventLoopTimer(EventLoop* l);
-    EventLoopTimer(const EventLoopTimer&) = delete;
-    EventLoopTimer& operator=(const EventLoopTimer&) = delete;
-
-private:
-    EventLoop* loop;
-    std::function<void()> callback;
-    double interval;
-    uint32_t when;
-
-    friend class EventLoopHack;
-    friend class EventLoop;
-};
-
-class EventLoop
+class EventLoop : public Host
 {
 public:
     static EventLoop* eventLoop();
@@ -60,24 +17,34 @@ public:
 
     void onEvent(const std::function<bool(const std::shared_ptr<EventLoopEvent>&)>& on);
     void onTerminate(const std::function<void()>& on);
-    void postEvent(const std::shared_ptr<EventLoopEvent>& evt);
+    // called when the loop is about to block waiting for events
+    void onIdle(const std::function<void()>& on);
+    void postEvent(const std::shared_ptr<EventLoopEvent>& evt) override;
+
+    void wakeup() override;
+
+    // a MessagePortRemote to the named client
+    std::shared_ptr<HostPort> connect(const std::string& name) override;
 
-    void wakeup();
+    uint64_t now() const override;
 
-    std::shared_ptr<EventLoopTimer> makeTimer();
+    // fires whatever timers are due, the loop does this by itself. Lets
+    // benchmarks drive timers without a running NSApplication.
+    void processTimers();
+
+    size_t pendingEvents() const;
+    size_t pendingTimers() const;
 
 private:
     EventLoop();
     EventLoop(const EventLoop&) = delete;
     EventLoop& operator=(const EventLoop&) = delete;
 
-    void startTimer(uint32_t when, EventLoopTimer::Type type, const std::shared_ptr<EventLoopTimer>& timer);
-    bool stopTimer(const std::shared_ptr<EventLoopTimer>& timer);
+    void startTimer(uint32_t when, EventLoopTimer::Type type, const std::shared_ptr<EventLoopTimer>& timer) override;
+    bool stopTimer(const std::shared_ptr<EventLoopTimer>& timer) override;
 
 private:
     static EventLoop* sEventLoop;
-
-    friend class EventLoopTimer;
 };
 
 #endif
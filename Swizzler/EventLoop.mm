@@ -1,90 +1,18 @@
 #include "EventLoop.h"
+#include "MessagePort.h"
 #include <deque>
 #include <unordered_set>
 #include <stdio.h>
 #include <objc/runtime.h>
 #include <pthread.h>
 #include "CocoaUtils.h"
+#include "ThreadLocalStore.h"
+#include "Metrics.h"
 #import  <Cocoa/Cocoa.h>
 
-// silly Apple making me do this, I hear Xcode 8 will have thread_local, just ~6 years late
-template<typename T>
-class ThreadLocalStore
-{
-public:
-    ThreadLocalStore()
-    {
-        pthread_once(&tlsOnce, init);
-    }
-
-    void set(const T& t)
-    {
-        if (void* ptr = pthread_getspecific(tls)) {
-            *static_cast<T*>(ptr) = t;
-        } else {
-            pthread_setspecific(tls, new T(t));
-        }
-    }
-
-    void remove()
-    {
-        if (void* ptr =pthread_getspecific(tls)) {
-            delete static_cast<T*>(ptr);
-            pthread_setspecific(tls, 0);
-        }
-    }
-
-    T* get()
-    {
-        if (void* ptr = pthread_getspecific(tls)) {
-            return static_cast<T*>(ptr);
-        } else {
-            T* t = new T;
-            pthread_setspecific(tls, t);
-            return t;
-        }
-    }
-    const T* get() const
-    {
-        if (const void* ptr = pthread_getspecific(tls)) {
-            return static_cast<const T*>(ptr);
-        } else {
-            T* t = new T;
-            pthread_setspecific(tls, t);
-            return t;
-        }
-    }
-    T* operator->()
-    {
-        return get();
-    }
-    const T* operator->() const
-    {
-        return get();
-    }
-
-private:
-    static void init()
-    {
-        pthread_key_create(&tls, destroy);
-    }
-    static void destroy(void* obj)
-    {
-        delete static_cast<T*>(obj);
-    }
-
-private:
-    static pthread_once_t tlsOnce;
-    static pthread_key_t tls;
-};
-
-template<typename T>
-pthread_once_t ThreadLocalStore<T>::tlsOnce = PTHREAD_ONCE_INIT;
-template<typename T>
-pthread_key_t ThreadLocalStore<T>::tls;
-
 static std::function<bool(const std::shared_ptr<EventLoopEvent>&)> sEventCallback;
 static std::function<void()> sTerminateCallback;
+static std::function<void()> sIdleCallback;
 static std::deque<std::shared_ptr<EventLoopEvent> > sPendingEvents;
 std::map<double, std::vector<std::pair<EventLoopTimer::Type, std::weak_ptr<EventLoopTimer> > > > sTimers;
 static std::unordered_set<NSEvent*> sKnownEvents;
@@ -112,6 +40,7 @@ static inline void fireTimers()
 {
     ScopedPool pool;
     auto now = [[NSDate date] timeIntervalSince1970];
+    static Metrics::Value& fired = Metrics::instance()->counter("timers_fired");
 
     // first call all timers
     {
@@ -127,6 +56,7 @@ static inline void fireTimers()
             while (t != vec.end()) {
                 if (auto shared = t->second.lock()) {
                     (*shared)();
+                    fired.add();
                 }
                 ++t;
             }
@@ -178,28 +108,122 @@ static uintptr_t ProcessPending2 = reinterpret_cast<uintptr_t>(&ProcessPending2)
 
 EventLoop* EventLoop::sEventLoop = 0;
 
-EventLoopEvent::EventLoopEvent(const KeyEvent& evt)
-    : kevt(evt), nsevt(0)
+MouseEvent::MouseEvent(NSEvent* event)
 {
+    internal = std::make_shared<Disseminate::Mouse::EventT>();
+    switch ([event type]) {
+    case NSLeftMouseDown:
+        internal->type = Disseminate::Mouse::Type_Press;
+        internal->button = Disseminate::Mouse::Button_Left;
+        break;
+    case NSLeftMouseUp:
+        internal->type = Disseminate::Mouse::Type_Release;
+        internal->button = Disseminate::Mouse::Button_Left;
+        break;
+    case NSRightMouseDown:
+        internal->type = Disseminate::Mouse::Type_Press;
+        internal->button = Disseminate::Mouse::Button_Right;
+        break;
+    case NSRightMouseUp:
+        internal->type = Disseminate::Mouse::Type_Release;
+        internal->button = Disseminate::Mouse::Button_Right;
+        break;
+    case NSMouseMoved:
+        internal->type = Disseminate::Mouse::Type_Move;
+        internal->button = Disseminate::Mouse::Button_None;
+        internal->delta = std::make_unique<Disseminate::Mouse::Location>([event deltaX], [event deltaY]);
+        break;
+    case NSLeftMouseDragged:
+        internal->type = Disseminate::Mouse::Type_Move;
+        internal->button = Disseminate::Mouse::Button_Left;
+        internal->delta = std::make_unique<Disseminate::Mouse::Location>([event deltaX], [event deltaY]);
+        break;
+    case NSRightMouseDragged:
+        internal->type = Disseminate::Mouse::Type_Move;
+        internal->button = Disseminate::Mouse::Button_Right;
+        internal->delta = std::make_unique<Disseminate::Mouse::Location>([event deltaX], [event deltaY]);
+        break;
+    default:
+        abort();
+        break;
+    }
+    {
+        NSPoint location = [event locationInWindow];
+        internal->location = std::make_unique<Disseminate::Mouse::Location>(location.x, location.y);
+    }
+    internal->modifiers = [event modifierFlags];
+    internal->clickCount = [event clickCount];
+    internal->pressure = [event pressure];
+    internal->timestamp = [event timestamp];
 }
 
-EventLoopEvent::EventLoopEvent(const MouseEvent& evt)
-    : mevt(evt), nsevt(0)
+KeyEvent::KeyEvent(NSEvent* event)
 {
+    internal = std::make_shared<Disseminate::Key::EventT>();
+    switch ([event type]) {
+    case NSKeyUp:
+        internal->type = Disseminate::Key::Type_Up;
+        break;
+    case NSKeyDown:
+        internal->type = Disseminate::Key::Type_Down;
+        break;
+    default:
+        abort();
+        break;
+    }
+    {
+        NSPoint location = [event locationInWindow];
+        internal->location = std::make_unique<Disseminate::Key::Location>(location.x, location.y);
+    }
+    internal->text = toStdString([event characters]);
+    internal->keyCode = [event keyCode];
+    internal->modifiers = [event modifierFlags];
+    internal->timestamp = [event timestamp];
+    internal->repeat = [event isARepeat];
 }
 
-EventLoopEvent::EventLoopEvent(NSEvent* evt)
-    : nsevt(evt)
+// the script engine only sees mouse and key events, and only as
+// our own types
+static inline std::shared_ptr<EventLoopEvent> fromNSEvent(NSEvent* event)
 {
-    [nsevt retain];
+    switch ([event type]) {
+    case NSLeftMouseDown:
+    case NSLeftMouseUp:
+    case NSRightMouseDown:
+    case NSRightMouseUp:
+    case NSMouseMoved:
+    case NSLeftMouseDragged:
+    case NSRightMouseDragged:
+        return std::make_shared<EventLoopEvent>(MouseEvent(event));
+    case NSKeyDown:
+    case NSKeyUp:
+        return std::make_shared<EventLoopEvent>(KeyEvent(event));
+    default:
+        break;
+    }
+    return std::shared_ptr<EventLoopEvent>();
 }
 
-EventLoopEvent::~EventLoopEvent()
+class RemotePort : public HostPort
 {
-    if (nsevt) {
-        [nsevt release];
+public:
+    RemotePort(const std::string& name)
+        : port(name)
+    {
     }
-}
+
+    // a peer that doesn't drain its queue makes a send wait the whole
+    // timeout, the engine stops routing to it after the first failure
+    enum { SendTimeout = 50 };
+
+    bool send(int32_t id, const uint8_t* data, size_t size) override
+    {
+        return port.send(id, data, size, SendTimeout / 1000.);
+    }
+
+private:
+    MessagePortRemote port;
+};
 
 EventLoop::EventLoop()
 {
@@ -414,7 +438,16 @@ static NSEvent* patchedNextEventMatchingMask(id self, SEL _cmd, NSUInteger mask,
             else
                 exp = [nextTimer earlierDate:expiration];
         }
-        event = sig(self, _cmd, mask, exp, mode, flag);
+        event = 0;
+        if (sIdleCallback && sPendingEvents.empty() && exp && [exp timeIntervalSinceNow] > 0) {
+            // we're about to block, see if there's anything
+            // queued up first and if not, give idle work a go
+            event = sig(self, _cmd, mask, [NSDate distantPast], mode, flag);
+            if (!event)
+                sIdleCallback();
+        }
+        if (!event)
+            event = sig(self, _cmd, mask, exp, mode, flag);
         if (!event) {
             if (exp != expiration) {
                 fireTimers();
@@ -450,9 +483,10 @@ static NSEvent* patchedNextEventMatchingMask(id self, SEL _cmd, NSUInteger mask,
                 continue;
             }
         }
-#warning maybe only look at mouse/key events or give eventloop a list of wanted types?
-        std::shared_ptr<EventLoopEvent> shared = std::make_shared<EventLoopEvent>(event);
-        if (sEventCallback && !sEventCallback(shared)) {
+        std::shared_ptr<EventLoopEvent> shared;
+        if (sEventCallback)
+            shared = fromNSEvent(event);
+        if (shared && !sEventCallback(shared)) {
             NSPoint loc = [event locationInWindow];
             printf("blocking real event %lu window %lu %f %f ctx %p ts %f\n", [event type], [event windowNumber], loc.x, loc.y, [event context], [event timestamp]);
             //[event release];
@@ -541,6 +575,11 @@ void EventLoop::postEvent(const std::shared_ptr<EventLoopEvent>& evt)
     wakeup();
 }
 
+std::shared_ptr<HostPort> EventLoop::connect(const std::string& name)
+{
+    return std::make_shared<RemotePort>(name);
+}
+
 void EventLoop::wakeup()
 {
     if (sProcessingPending)
@@ -598,22 +637,50 @@ void EventLoop::onTerminate(const std::function<void()>& on)
     sTerminateCallback = on;
 }
 
-std::shared_ptr<EventLoopTimer> EventLoop::makeTimer()
+void EventLoop::onIdle(const std::function<void()>& on)
+{
+    sIdleCallback = on;
+}
+
+uint64_t EventLoop::now() const
+{
+    return timeInNanoseconds();
+}
+
+void EventLoop::processTimers()
+{
+    fireTimers();
+}
+
+size_t EventLoop::pendingEvents() const
+{
+    return sPendingEvents.size();
+}
+
+size_t EventLoop::pendingTimers() const
 {
-    return std::shared_ptr<EventLoopTimer>(new EventLoopTimer(this));
+    size_t count = 0;
+    for (const auto& bucket : sTimers) {
+        for (const auto& t : bucket.second) {
+            if (!t.second.expired())
+                ++count;
+        }
+    }
+    return count;
 }
 
 void EventLoop::startTimer(uint32_t when, EventLoopTimer::Type type, const std::shared_ptr<EventLoopTimer>& timer)
 {
     const double interval = makeInterval(when);
     sTimers[interval].push_back(std::make_pair(type, timer));
-    timer->interval = interval;
-    timer->when = when;
+    due(timer.get()) = interval;
+    timeout(timer.get()) = when;
 }
 
 bool EventLoop::stopTimer(const std::shared_ptr<EventLoopTimer>& timer)
 {
-    auto& vec = sTimers[timer->interval];
+    const double interval = due(timer.get());
+    auto& vec = sTimers[interval];
     if (vec.empty())
         return false;
     auto t = vec.begin();
@@ -622,7 +689,7 @@ bool EventLoop::stopTimer(const std::shared_ptr<EventLoopTimer>& timer)
             if (shared == timer) {
                 vec.erase(t);
                 if (vec.empty())
-                    sTimers.erase(timer->interval);
+                    sTimers.erase(interval);
                 return true;
             }
             ++t;
@@ -631,30 +698,10 @@ bool EventLoop::stopTimer(const std::shared_ptr<EventLoopTimer>& timer)
         }
     }
     if (vec.empty())
-        sTimers.erase(timer->interval);
+        sTimers.erase(interval);
     return false;
 }
 
-EventLoopTimer::EventLoopTimer(EventLoop* l)
-    : loop(l), interval(0.), when(0)
-{
-}
-
-void EventLoopTimer::start(uint32_t timeout, Type type)
-{
-    loop->startTimer(timeout, type, shared_from_this());
-}
-
-bool EventLoopTimer::stop()
-{
-    return loop->stopTimer(shared_from_this());
-}
-
-void EventLoopTimer::onTimeout(const std::function<void()>& func)
-{
-    callback = func;
-}
-
 // void EventLoop::addEvent(Event&& event)
 // {
 // }
@@ -0,0 +1,31 @@
+#include "Host.h"
+
+std::shared_ptr<EventLoopTimer> Host::makeTimer()
+{
+    return std::shared_ptr<EventLoopTimer>(new EventLoopTimer(this));
+}
+
+EventLoopTimer::EventLoopTimer(Host* h)
+    : host(h), interval(0.), when(0)
+{
+}
+
+void EventLoopTimer::start(uint32_t timeout, Type type)
+{
+    host->startTimer(timeout, type, shared_from_this());
+}
+
+void EventLoopTimer::restart(uint32_t timeout)
+{
+    start(timeout ? timeout : 1, Timeout);
+}
+
+bool EventLoopTimer::stop()
+{
+    return host->stopTimer(shared_from_this());
+}
+
+void EventLoopTimer::onTimeout(const std::function<void()>& func)
+{
+    callback = func;
+}
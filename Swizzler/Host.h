@@ -0,0 +1,99 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include "Events.h"
+
+class Host;
+
+// an input event on its way in or out of the app
+class EventLoopEvent
+{
+public:
+    EventLoopEvent(const KeyEvent& event) : kevt(event) { }
+    EventLoopEvent(const MouseEvent& event) : mevt(event) { }
+
+    // exactly one of these is valid
+    KeyEvent kevt;
+    MouseEvent mevt;
+};
+
+// where messages for another client go, that client's port in the real app
+class HostPort
+{
+public:
+    virtual ~HostPort() { }
+
+    // data only has to stay valid for the duration of the call
+    virtual bool send(int32_t id, const uint8_t* data, size_t size) = 0;
+    bool send(int32_t id, const std::vector<uint8_t>& data) { return send(id, data.empty() ? 0 : &data[0], data.size()); }
+};
+
+class EventLoopTimer : public std::enable_shared_from_this<EventLoopTimer>
+{
+public:
+    enum Type { Timeout, Interval };
+
+    void start(uint32_t timeout, Type type = Timeout);
+    bool stop();
+
+    // a one shot start that is safe from within the timer's own callback.
+    // A timer is removed once it has fired, so a restart from there has to
+    // land in the future or it's dropped along with it. timeout is at least 1
+    void restart(uint32_t timeout);
+
+    void onTimeout(const std::function<void()>& func);
+
+    void operator()() { callback(); }
+
+private:
+    EventLoopTimer(Host* h);
+    EventLoopTimer(const EventLoopTimer&) = delete;
+    EventLoopTimer& operator=(const EventLoopTimer&) = delete;
+
+private:
+    Host* host;
+    std::function<void()> callback;
+    double interval; // when the timer is due, in whatever unit the host keeps time
+    uint32_t when;
+
+    friend class EventLoopHack;
+    friend class Host;
+};
+
+// What the script engine and its helpers need from the app they run in:
+// timers, a clock, somewhere to inject events and ports to the other
+// clients. EventLoop implements it on top of the swizzled NSApplication,
+// SimulatedHost without any app at all. Nothing outside of the host
+// implementations knows about Cocoa.
+class Host
+{
+public:
+    virtual ~Host() { }
+
+    std::shared_ptr<EventLoopTimer> makeTimer();
+
+    virtual void postEvent(const std::shared_ptr<EventLoopEvent>& evt) = 0;
+    virtual void wakeup() = 0;
+
+    virtual std::shared_ptr<HostPort> connect(const std::string& name) = 0;
+
+    // monotonic nanoseconds
+    virtual uint64_t now() const = 0;
+
+protected:
+    virtual void startTimer(uint32_t when, EventLoopTimer::Type type, const std::shared_ptr<EventLoopTimer>& timer) = 0;
+    virtual bool stopTimer(const std::shared_ptr<EventLoopTimer>& timer) = 0;
+
+    static double& due(EventLoopTimer* timer) { return timer->interval; }
+    static uint32_t& timeout(EventLoopTimer* timer) { return timer->when; }
+
+    friend class EventLoopTimer;
+};
+
+#endif
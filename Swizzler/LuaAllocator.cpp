@@ -0,0 +1,113 @@
+#include "LuaAllocator.h"
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+LuaAllocator::LuaAllocator()
+    : mCursor(0), mEnd(0)
+{
+    memset(mFree, 0, sizeof(mFree));
+}
+
+LuaAllocator::~LuaAllocator()
+{
+    for (void* arena : mArenas) {
+        free(arena);
+    }
+}
+
+void* LuaAllocator::alloc(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+    LuaAllocator* allocator = static_cast<LuaAllocator*>(ud);
+    if (!ptr) {
+        // osize is the type of the object being created, not a size
+        return nsize ? allocator->allocate(nsize) : 0;
+    }
+    if (!nsize) {
+        allocator->deallocate(ptr, osize);
+        return 0;
+    }
+    return allocator->reallocate(ptr, osize, nsize);
+}
+
+void* LuaAllocator::allocateFromArena(size_t size)
+{
+    if (mCursor + size > mEnd) {
+        // the tail of the previous arena is abandoned, it's at most MaxPooled bytes
+        char* arena = static_cast<char*>(malloc(ArenaSize));
+        if (!arena)
+            return 0;
+        ++mStats.systemAllocations;
+        mArenas.push_back(arena);
+        mCursor = arena;
+        mEnd = arena + ArenaSize;
+        mStats.arenaBytes += ArenaSize;
+    }
+    void* ptr = mCursor;
+    mCursor += size;
+    return ptr;
+}
+
+void* LuaAllocator::allocate(size_t size)
+{
+    void* ptr;
+    if (size > MaxPooled) {
+        ptr = malloc(size);
+        ++mStats.systemAllocations;
+    } else {
+        const size_t cls = sizeClass(size);
+        if (FreeNode* node = mFree[cls]) {
+            mFree[cls] = node->next;
+            ptr = node;
+        } else {
+            ptr = allocateFromArena((cls + 1) * Granularity);
+        }
+    }
+    if (ptr) {
+        mStats.bytes += size;
+        ++mStats.allocations;
+        ++mStats.totalAllocations;
+    }
+    return ptr;
+}
+
+void LuaAllocator::deallocate(void* ptr, size_t size)
+{
+    if (size > MaxPooled) {
+        free(ptr);
+    } else {
+        const size_t cls = sizeClass(size);
+        FreeNode* node = static_cast<FreeNode*>(ptr);
+        node->next = mFree[cls];
+        mFree[cls] = node;
+    }
+    mStats.bytes -= size;
+    --mStats.allocations;
+}
+
+void* LuaAllocator::reallocate(void* ptr, size_t osize, size_t nsize)
+{
+    if (osize > MaxPooled && nsize > MaxPooled) {
+        void* nptr = realloc(ptr, nsize);
+        ++mStats.systemAllocations;
+        if (nptr) {
+            mStats.bytes += nsize;
+            mStats.bytes -= osize;
+        }
+        return nptr;
+    }
+    if (osize <= MaxPooled && nsize <= MaxPooled && sizeClass(osize) == sizeClass(nsize)) {
+        // still fits in the same block
+        mStats.bytes += nsize;
+        mStats.bytes -= osize;
+        return ptr;
+    }
+    void* nptr = allocate(nsize);
+    if (!nptr) {
+        // lua expects shrinking to never fail, keep the larger block
+        return nsize <= osize ? ptr : 0;
+    }
+    memcpy(nptr, ptr, std::min(osize, nsize));
+    deallocate(ptr, osize);
+    return nptr;
+}
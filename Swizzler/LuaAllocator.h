@@ -0,0 +1,67 @@
+#ifndef LUAALLOCATOR_H
+#define LUAALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Size-class pool allocator for a lua_State. Small blocks are carved out of
+// large arenas and recycled through per-class free lists so that the churn
+// of event handlers never reaches the host application's malloc.
+class LuaAllocator
+{
+public:
+    LuaAllocator();
+    ~LuaAllocator();
+
+    // lua_Alloc compatible entry point, ud must be a LuaAllocator
+    static void* alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    struct Stats
+    {
+        Stats()
+            : bytes(0), allocations(0), totalAllocations(0), systemAllocations(0), arenaBytes(0)
+        {
+        }
+
+        uint64_t bytes;            // live bytes handed out to lua
+        uint64_t allocations;      // live blocks handed out to lua
+        uint64_t totalAllocations; // blocks handed out since creation
+        uint64_t systemAllocations; // malloc/realloc calls since creation, arenas included
+        uint64_t arenaBytes;       // bytes reserved from the system for pools
+    };
+
+    const Stats& stats() const { return mStats; }
+
+private:
+    LuaAllocator(const LuaAllocator&) = delete;
+    LuaAllocator& operator=(const LuaAllocator&) = delete;
+
+    void* allocate(size_t size);
+    void deallocate(void* ptr, size_t size);
+    void* reallocate(void* ptr, size_t osize, size_t nsize);
+
+    void* allocateFromArena(size_t size);
+
+    enum {
+        Granularity = 16,
+        MaxPooled = 256,
+        ClassCount = MaxPooled / Granularity,
+        ArenaSize = 64 * 1024
+    };
+
+    static inline size_t sizeClass(size_t size) { return (size - 1) / Granularity; }
+
+    struct FreeNode
+    {
+        FreeNode* next;
+    };
+
+    FreeNode* mFree[ClassCount];
+    std::vector<void*> mArenas;
+    char* mCursor;
+    char* mEnd;
+    Stats mStats;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "MessageHandler.h"
+#include "ScriptEngine.h"
+#include "Host.h"
+#include "FlatbufferEncoder.h"
+#include "Metrics.h"
+#include <FlatbufferTypes.h>
+#include <Identity_generated.h>
+#include <PeerState_generated.h>
+#include <string.h>
+#include <string>
+
+static inline std::string toString(const std::vector<uint8_t>& vec)
+{
+    return std::string(reinterpret_cast<const char*>(&vec[0]), vec.size());
+}
+
+MessageHandler::MessageHandler(ScriptEngine* engine, Host* host)
+    : mEngine(engine), mHost(host)
+{
+}
+
+void MessageHandler::operator()(int32_t id, const std::vector<uint8_t>& data)
+{
+    switch (id) {
+    case Disseminate::FlatbufferTypes::Evaluate:
+        mEngine->evaluate(toString(data));
+        mHost->wakeup();
+        break;
+    case Disseminate::FlatbufferTypes::RemoteAdd: {
+        auto event = Disseminate::RemoteAdd::GetEvent(&data[0])->UnPack();
+        mEngine->registerClient(ScriptEngine::Remote, event);
+        mHost->wakeup();
+        break; }
+    case Disseminate::FlatbufferTypes::RemoteRemove:
+        mEngine->unregisterClient(ScriptEngine::Remote, toString(data));
+        mHost->wakeup();
+        break;
+    case Disseminate::FlatbufferTypes::RemoteClear:
+        mEngine->clearClients(ScriptEngine::Remote);
+        mHost->wakeup();
+        break;
+    case Disseminate::FlatbufferTypes::MouseEvent: {
+        auto event = Disseminate::Mouse::GetEvent(&data[0])->UnPack();
+        mEngine->processRemoteMouseEvent(event);
+        mHost->wakeup();
+        break; }
+    case Disseminate::FlatbufferTypes::KeyEvent: {
+        auto event = Disseminate::Key::GetEvent(&data[0])->UnPack();
+        mEngine->processRemoteKeyEvent(event);
+        mHost->wakeup();
+        break; }
+    case Disseminate::FlatbufferTypes::CompactMouseEvent: {
+        Disseminate::Compact::MouseRecord record;
+        if (data.size() != sizeof(record)) {
+            Metrics::instance()->counter("events_dropped").add();
+            break;
+        }
+        memcpy(&record, &data[0], sizeof(record));
+        mEngine->processRemoteMouseEvent(record);
+        mHost->wakeup();
+        break; }
+    case Disseminate::FlatbufferTypes::CompactKeyEvent: {
+        Disseminate::Compact::KeyRecord record;
+        if (data.size() != sizeof(record)) {
+            Metrics::instance()->counter("events_dropped").add();
+            break;
+        }
+        memcpy(&record, &data[0], sizeof(record));
+        mEngine->processRemoteKeyEvent(record);
+        mHost->wakeup();
+        break; }
+    case Disseminate::FlatbufferTypes::Identity:
+        mEngine->setSenderId(Disseminate::Identity::GetEvent(&data[0])->id());
+        break;
+    case Disseminate::FlatbufferTypes::Settings: {
+        mEngine->processSettings(Disseminate::Settings::GetGlobal(&data[0]));
+        mHost->wakeup();
+        break; }
+    case Disseminate::FlatbufferTypes::ScriptStatsRequest: {
+        Disseminate::ScriptStats::StatsT stats;
+        mEngine->collectStats(stats);
+
+        FlatbufferEncoder encoder;
+        encoder.finish(Disseminate::ScriptStats::CreateStats(encoder.builder(), &stats));
+        if (mReply)
+            mReply(Disseminate::FlatbufferTypes::ScriptStats, encoder.data(), encoder.size());
+        break; }
+    case Disseminate::FlatbufferTypes::Terminate:
+        if (mTerminate)
+            mTerminate();
+        break;
+    case Disseminate::FlatbufferTypes::Heartbeat: {
+        const std::string& uuid = mEngine->uuid();
+        if (mReply)
+            mReply(Disseminate::FlatbufferTypes::Heartbeat, reinterpret_cast<const uint8_t*>(uuid.data()), uuid.size());
+        break; }
+    case Disseminate::FlatbufferTypes::PeerState: {
+        const auto event = Disseminate::PeerState::GetEvent(&data[0]);
+        if (event->uuid())
+            mEngine->setPeerState(event->uuid()->str(), event->degraded());
+        break; }
+    default:
+        break;
+    }
+}
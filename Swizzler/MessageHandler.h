@@ -0,0 +1,37 @@
+#ifndef MESSAGEHANDLER_H
+#define MESSAGEHANDLER_H
+
+#include <functional>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+class ScriptEngine;
+class Host;
+
+// Decodes the messages that arrive on our local port and hands them to
+// the script engine. Anything that has to leave the process, replies to
+// the controller and terminating the app, goes through callbacks so the
+// handler runs the same against a real app and a SimulatedHost.
+class MessageHandler
+{
+public:
+    MessageHandler(ScriptEngine* engine, Host* host);
+
+    typedef std::function<void(int32_t id, const uint8_t* data, size_t size)> ReplyCallback;
+    void onReply(const ReplyCallback& on) { mReply = on; }
+    void onTerminate(const std::function<void()>& on) { mTerminate = on; }
+
+    void operator()(int32_t id, const std::vector<uint8_t>& data);
+
+private:
+    MessageHandler(const MessageHandler&) = delete;
+    MessageHandler& operator=(const MessageHandler&) = delete;
+
+    ScriptEngine* mEngine;
+    Host* mHost;
+    ReplyCallback mReply;
+    std::function<void()> mTerminate;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "Replayer.h"
+#include "Host.h"
+#include "FlatbufferTypes.h"
+#include <stdio.h>
+
+Replayer::Replayer(Host* host, const std::string& path, double speed)
+    : mHost(host), mReader(path), mSpeed(speed), mHasNext(false), mFirst(0), mStart(0), mDelivered(0)
+{
+}
+
+Replayer::~Replayer()
+{
+    if (mTimer)
+        mTimer->stop();
+}
+
+bool Replayer::start(const Handler& handler)
+{
+    if (!mReader.isOpen())
+        return false;
+    mHandler = handler;
+    mHasNext = mReader.next(mNext);
+    if (!mHasNext) {
+        finish();
+        return true;
+    }
+    mFirst = mNext.timestamp;
+    mStart = mHost->now();
+
+    if (mSpeed <= 0) {
+        // as fast as we can, on the spot so nothing else interleaves
+        do {
+            deliver(mNext);
+        } while (mReader.next(mNext));
+        mHasNext = false;
+        finish();
+        return true;
+    }
+
+    mTimer = mHost->makeTimer();
+    mTimer->onTimeout([this]() { advance(); });
+    advance();
+    return true;
+}
+
+void Replayer::deliver(const EventLog::Reader::Record& record)
+{
+    switch (record.type) {
+    case Disseminate::FlatbufferTypes::Terminate:
+        // a replay shouldn't take the app down with it
+        return;
+    case Disseminate::FlatbufferTypes::ScriptStatsRequest:
+    case Disseminate::FlatbufferTypes::Heartbeat:
+        // the controller isn't waiting for answers to these
+        return;
+    default:
+        break;
+    }
+    mBuffer.assign(record.data, record.data + record.size);
+    mHandler(record.type, mBuffer);
+    ++mDelivered;
+}
+
+void Replayer::advance()
+{
+    const uint64_t elapsed = (mHost->now() - mStart) * mSpeed;
+    while (mHasNext && mNext.timestamp - mFirst <= elapsed) {
+        deliver(mNext);
+        mHasNext = mReader.next(mNext);
+    }
+    if (!mHasNext) {
+        finish();
+        return;
+    }
+    const uint64_t wait = (mNext.timestamp - mFirst - elapsed) / mSpeed;
+    mTimer->restart(wait / 1000000);
+}
+
+void Replayer::finish()
+{
+    const double seconds = (mHost->now() - mStart) / 1000000000.;
+    printf("replay done, %llu records in %.3fs (%.0f/s)\n",
+           static_cast<unsigned long long>(mDelivered), seconds,
+           seconds > 0 ? mDelivered / seconds : 0.);
+}
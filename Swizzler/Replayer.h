@@ -0,0 +1,47 @@
+#ifndef REPLAYER_H
+#define REPLAYER_H
+
+#include "EventLog.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Host;
+class EventLoopTimer;
+
+// Feeds a recorded EventLog back through the message handler, captured
+// input shows up as remote Mouse/Key events. A speed of 1 keeps the
+// original timing, 2 plays twice as fast and so on, 0 pushes everything
+// through at once and reports the throughput.
+class Replayer
+{
+public:
+    typedef std::function<void(int32_t type, const std::vector<uint8_t>& data)> Handler;
+
+    Replayer(Host* host, const std::string& path, double speed);
+    ~Replayer();
+
+    bool start(const Handler& handler);
+
+private:
+    Replayer(const Replayer&) = delete;
+    Replayer& operator=(const Replayer&) = delete;
+
+    void deliver(const EventLog::Reader::Record& record);
+    void advance();
+    void finish();
+
+    Host* mHost;
+    EventLog::Reader mReader;
+    double mSpeed;
+    Handler mHandler;
+    std::shared_ptr<EventLoopTimer> mTimer;
+    EventLog::Reader::Record mNext;
+    bool mHasNext;
+    uint64_t mFirst, mStart; // recorded and actual start, nanoseconds
+    uint64_t mDelivered;
+    std::vector<uint8_t> mBuffer;
+};
+
+#endif
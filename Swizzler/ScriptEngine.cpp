@@ -0,0 +1,1562 @@
+#include "ScriptEngine.h"
+#include "LuaAllocator.h"
+#include "EventBindings.h"
+#include "SettingsSnapshot.h"
+#include "Sequencer.h"
+#include "Coroutines.h"
+#include "Host.h"
+#include "FlatbufferTypes.h"
+#include "CompactEvents.h"
+#include "Protocol.h"
+#include "FlatbufferEncoder.h"
+#include "EventLog.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <string.h>
+#include "Events.h"
+
+namespace enums {
+enum { Add, Remove };
+}
+
+// the count hook fires every HookGranularity VM instructions
+enum { HookGranularity = 100 };
+
+struct HandlerStats
+{
+    HandlerStats()
+        : invocations(0), totalTime(0), maxTime(0), instructions(0), aborted(0)
+    {
+    }
+
+    uint64_t invocations;
+    uint64_t totalTime, maxTime; // nanoseconds
+    uint64_t instructions;
+    uint64_t aborted;
+};
+
+struct GcStats
+{
+    GcStats()
+        : slices(0), cycles(0), totalTime(0), lastSlice(0), maxSlice(0)
+    {
+    }
+
+    uint64_t slices, cycles;
+    uint64_t totalTime, lastSlice, maxSlice; // nanoseconds
+};
+
+// a lua function kept alive through a registry reference. Event handlers
+// run through coroutines so that they can await
+class LuaFunction
+{
+public:
+    LuaFunction(lua_State* l, int idx, Coroutines* c = 0)
+        : coroutines(c)
+    {
+        // always call on the main thread, l might be a coroutine
+        lua_rawgeti(l, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+        main = lua_tothread(l, -1);
+        lua_pop(l, 1);
+        lua_pushvalue(l, idx);
+        ref = luaL_ref(l, LUA_REGISTRYINDEX);
+    }
+    LuaFunction(LuaFunction&& other) noexcept
+        : coroutines(other.coroutines), main(other.main), ref(other.ref)
+    {
+        other.ref = LUA_NOREF;
+    }
+    ~LuaFunction()
+    {
+        if (ref != LUA_NOREF)
+            luaL_unref(main, LUA_REGISTRYINDEX, ref);
+    }
+
+    template<typename T>
+    bool operator()(int type, const T& event)
+    {
+        lua_rawgeti(main, LUA_REGISTRYINDEX, ref);
+        lua_pushinteger(main, type);
+        EventBindings::push(main, event);
+        if (coroutines)
+            return coroutines->call(main, 2);
+        if (lua_pcall(main, 2, 1, 0) != LUA_OK) {
+            printf("error: %s\n", lua_tostring(main, -1));
+            lua_pop(main, 1);
+            return true;
+        }
+        const bool ret = lua_toboolean(main, -1) != 0;
+        lua_pop(main, 1);
+        return ret;
+    }
+
+    void operator()(lua_Integer arg)
+    {
+        lua_rawgeti(main, LUA_REGISTRYINDEX, ref);
+        lua_pushinteger(main, arg);
+        if (lua_pcall(main, 1, 0, 0) != LUA_OK) {
+            printf("error: %s\n", lua_tostring(main, -1));
+            lua_pop(main, 1);
+        }
+    }
+
+private:
+    LuaFunction(const LuaFunction&) = delete;
+    LuaFunction& operator=(const LuaFunction&) = delete;
+
+    Coroutines* coroutines;
+    lua_State* main;
+    int ref;
+};
+
+template<typename T>
+struct Handler
+{
+    Handler(T&& f)
+        : function(std::move(f))
+    {
+    }
+
+    T function;
+    HandlerStats stats;
+};
+
+// the engine's share of the process metrics, looked up once
+struct EngineMetrics
+{
+    Metrics::Value& captured;
+    Metrics::Value& received;
+    Metrics::Value& forwarded;
+    Metrics::Value& injected;
+    Metrics::Value& dropped;
+    Metrics::Value& luaCalls;
+    Metrics::Value& luaTime;
+
+    static EngineMetrics& get()
+    {
+        Metrics* metrics = Metrics::instance();
+        static EngineMetrics m = {
+            metrics->counter("events_captured"),
+            metrics->counter("events_received"),
+            metrics->counter("events_forwarded"),
+            metrics->counter("events_injected"),
+            metrics->counter("events_dropped"),
+            metrics->counter("lua_calls"),
+            metrics->counter("lua_time_ns")
+        };
+        return m;
+    }
+};
+
+class ScriptEngineData
+{
+public:
+    ScriptEngineData(const std::string& id, Host* h)
+        : uuid(id), host(h), senderId(0), stallPending(false), nextTimer(0), active(0), resumeStart(0), budget(0), eventInstructions(0), budgetExceeded(false),
+          gcSliceBudget(1000000), gcPending(true), gcAllocations(0), gcBaseline(0),
+          coroutines(h), sequencer(h)
+    {
+    }
+    ~ScriptEngineData()
+    {
+        if (stallPending)
+            stallTimer->stop();
+    }
+
+    // deques since handlers can be added while we're dispatching to them
+    std::deque<Handler<LuaFunction> > mouseEventFunctions;
+    std::deque<Handler<LuaFunction> > keyEventFunctions;
+    std::vector<sel::function<void(int, int, const std::string&, int)> > clientChangeFunctions;
+
+    struct Client
+    {
+        ScriptEngine::ClientType type;
+        std::string uuid;
+        uint32_t handle;
+    };
+    std::vector<Client> clients;
+
+    // uuids are interned to small integer handles when a client registers.
+    // A handle is freed when its client goes away but the uuid keeps its
+    // claim until the slot goes to someone else, freed handles are reused
+    // oldest first. A client that's cleared and added again, as every
+    // settings push does, gets its handle back so that handles held by
+    // scripts stay valid.
+    //
+    // Internally a handle is the slot index. Scripts see the slot's
+    // generation in the bits above IndexBits as well, it changes whenever
+    // the slot goes to another uuid so a handle kept for a client that
+    // left never reaches the next one.
+    enum { IndexBits = 20, GenerationMask = (1 << 11) - 1 };
+    std::unordered_map<std::string, uint32_t> handles;
+    std::vector<uint32_t> generations;
+    // indexed by handle, null if that client isn't currently connected
+    std::vector<std::shared_ptr<HostPort> > ports;
+    // indexed by handle, the uuid holding it and how many registrations do
+    std::vector<std::string> names;
+    std::vector<uint32_t> refs;
+    std::deque<uint32_t> freeHandles;
+
+    std::string uuid;
+    Host* host;
+    // our id in compact events, 0 until the controller has assigned one
+    uint16_t senderId;
+    // uuids of remote clients, indexed by their sender id
+    std::vector<std::string> senders;
+    // Protocol capabilities, indexed by handle
+    std::vector<uint64_t> capabilities;
+
+    std::shared_ptr<const SettingsSnapshot> settings;
+    // per client settings from the snapshot, indexed by handle
+    std::vector<std::shared_ptr<const SettingsSnapshot::Client> > clientSettings;
+    // our group, empty if we're not in one
+    std::string group;
+    // peers that stopped answering heartbeats, indexed by handle
+    std::vector<uint8_t> degraded;
+    // peers a send to failed or timed out, indexed by handle. They're left
+    // out until StallRetry ms have passed, so a frozen peer costs one send
+    // timeout per retry instead of one per event until the controller
+    // reports it degraded
+    std::vector<uint8_t> stalled;
+    std::shared_ptr<EventLoopTimer> stallTimer;
+    bool stallPending;
+    enum { StallRetry = 1000 };
+    // whether sendToAll goes to a client, indexed by handle. Everyone
+    // unless we're in a group, then only the other members, and never
+    // to degraded or stalled peers
+    std::vector<uint8_t> routed;
+
+    uint32_t intern(const std::string& name)
+    {
+        auto it = handles.find(name);
+        if (it != handles.end()) {
+            const uint32_t handle = it->second;
+            if (!refs[handle]) {
+                // back before anyone else took the slot
+                auto free = std::find(freeHandles.begin(), freeHandles.end(), handle);
+                if (free != freeHandles.end())
+                    freeHandles.erase(free);
+            }
+            return handle;
+        }
+        uint32_t handle;
+        if (!freeHandles.empty()) {
+            handle = freeHandles.front();
+            freeHandles.pop_front();
+            handles.erase(names[handle]);
+            names[handle] = name;
+            generations[handle] = (generations[handle] + 1) & GenerationMask;
+            capabilities[handle] = 0;
+            clientSettings[handle] = settings ? settings->forClient(name) : std::shared_ptr<const SettingsSnapshot::Client>();
+            degraded[handle] = 0;
+            stalled[handle] = 0;
+        } else {
+            handle = ports.size();
+            names.push_back(name);
+            generations.push_back(0);
+            refs.push_back(0);
+            ports.push_back(std::shared_ptr<HostPort>());
+            capabilities.push_back(0);
+            clientSettings.push_back(settings ? settings->forClient(name) : std::shared_ptr<const SettingsSnapshot::Client>());
+            degraded.push_back(0);
+            stalled.push_back(0);
+            routed.push_back(0);
+        }
+        handles[name] = handle;
+        routed[handle] = routes(handle);
+        return handle;
+    }
+    // ports.size() if the uuid was never interned or lost its handle
+    uint32_t find(const std::string& name) const
+    {
+        auto it = handles.find(name);
+        return it != handles.end() ? it->second : ports.size();
+    }
+    // what scripts get to see
+    int scriptHandle(uint32_t handle) const
+    {
+        return static_cast<int>(generations[handle] << IndexBits | handle);
+    }
+    // ports.size() if the script's handle is stale or was never valid
+    uint32_t resolve(lua_Integer scriptHandle) const
+    {
+        const uint32_t handle = scriptHandle & ((1 << IndexBits) - 1);
+        if (scriptHandle < 0 || handle >= ports.size()
+            || static_cast<uint32_t>(scriptHandle >> IndexBits) != generations[handle])
+            return ports.size();
+        return handle;
+    }
+    void retain(uint32_t handle)
+    {
+        ++refs[handle];
+    }
+    void release(uint32_t handle)
+    {
+        if (--refs[handle])
+            return;
+        ports[handle].reset();
+        capabilities[handle] = 0;
+        // the controller sends a fresh PeerState if it's still degraded
+        degraded[handle] = 0;
+        stalled[handle] = 0;
+        routed[handle] = routes(handle);
+        freeHandles.push_back(handle);
+    }
+    const std::shared_ptr<HostPort>& port(uint32_t handle) const
+    {
+        static const std::shared_ptr<HostPort> null;
+        return handle < ports.size() ? ports[handle] : null;
+    }
+    void makePort(uint32_t handle, const std::string& name)
+    {
+        ports[handle] = host->connect(name);
+    }
+    void removePort(uint32_t handle)
+    {
+        ports[handle].reset();
+    }
+
+    void setSender(uint16_t id, const std::string& name)
+    {
+        if (id >= senders.size())
+            senders.resize(id + 1);
+        senders[id] = name;
+    }
+    bool supports(uint32_t handle, uint64_t capability) const
+    {
+        return handle < capabilities.size() && (capabilities[handle] & capability) == capability;
+    }
+    const std::string& sender(uint16_t id) const
+    {
+        static const std::string null;
+        return id < senders.size() ? senders[id] : null;
+    }
+
+    void setSettings(const std::shared_ptr<const SettingsSnapshot>& snapshot)
+    {
+        settings = snapshot;
+        const auto self = settings->forClient(uuid);
+        group = self ? self->group : std::string();
+        for (const auto& handle : handles) {
+            clientSettings[handle.second] = settings->forClient(handle.first);
+        }
+        for (uint32_t handle = 0; handle < routed.size(); ++handle) {
+            routed[handle] = routes(handle);
+        }
+    }
+    bool reachable(uint32_t handle) const
+    {
+        return !degraded[handle] && !stalled[handle];
+    }
+    bool routes(uint32_t handle) const
+    {
+        if (!reachable(handle))
+            return false;
+        return group.empty() || (clientSettings[handle] && clientSettings[handle]->group == group);
+    }
+    void stall(uint32_t handle)
+    {
+        stalled[handle] = 1;
+        routed[handle] = 0;
+        if (stallPending)
+            return;
+        if (!stallTimer) {
+            stallTimer = host->makeTimer();
+            stallTimer->onTimeout([this]() { unstall(); });
+        }
+        stallTimer->start(StallRetry, EventLoopTimer::Timeout);
+        stallPending = true;
+    }
+    void unstall()
+    {
+        stallPending = false;
+        for (uint32_t handle = 0; handle < stalled.size(); ++handle) {
+            if (stalled[handle]) {
+                stalled[handle] = 0;
+                routed[handle] = routes(handle);
+            }
+        }
+    }
+
+    const SettingsSnapshot::RemapTable* remaps(uint32_t handle) const
+    {
+        if (handle >= clientSettings.size() || !clientSettings[handle] || clientSettings[handle]->remaps.empty())
+            return 0;
+        return &clientSettings[handle]->remaps;
+    }
+
+    uint32_t nextTimer;
+    std::map<uint32_t, std::shared_ptr<EventLoopTimer> > timers;
+
+    // profiling, active is the handler currently being dispatched to
+    HandlerStats* active;
+    // everything that runs after a handler's first await, summed up
+    HandlerStats coroutineStats;
+    uint64_t resumeStart;
+    uint64_t budget;
+    uint64_t eventInstructions;
+    bool budgetExceeded;
+
+    // garbage collection pacing
+    GcStats gc;
+    uint64_t gcSliceBudget; // nanoseconds
+    bool gcPending;
+    uint64_t gcAllocations; // total allocations when the last cycle finished
+    uint64_t gcBaseline;    // live bytes when the last cycle finished
+
+    // last so that pending coroutines and sequences go away before anything they refer to
+    Coroutines coroutines;
+    Sequencer sequencer;
+
+    void beginEvent()
+    {
+        eventInstructions = 0;
+        budgetExceeded = false;
+    }
+
+    template<typename T, typename... Args>
+    bool call(Handler<T>& handler, Args&&... args)
+    {
+        HandlerStats& stats = handler.stats;
+        active = &stats;
+        const uint64_t start = host->now();
+        const bool ret = handler.function(std::forward<Args>(args)...);
+        const uint64_t elapsed = host->now() - start;
+        active = 0;
+
+        ++stats.invocations;
+        stats.totalTime += elapsed;
+        EngineMetrics& metrics = EngineMetrics::get();
+        metrics.luaCalls.add();
+        metrics.luaTime.add(elapsed);
+        if (elapsed > stats.maxTime)
+            stats.maxTime = elapsed;
+        if (budgetExceeded) {
+            // an aborted handler never blocks the event
+            ++stats.aborted;
+            return true;
+        }
+        return ret;
+    }
+
+    // a coroutine woken by a timer or a key runs under a budget of its
+    // own, as if it was handling an event
+    void resumeScope(bool resuming)
+    {
+        if (resuming) {
+            beginEvent();
+            active = &coroutineStats;
+            resumeStart = host->now();
+            return;
+        }
+        const uint64_t elapsed = host->now() - resumeStart;
+        active = 0;
+        ++coroutineStats.invocations;
+        coroutineStats.totalTime += elapsed;
+        if (elapsed > coroutineStats.maxTime)
+            coroutineStats.maxTime = elapsed;
+        if (budgetExceeded)
+            ++coroutineStats.aborted;
+        // the handlers that may follow start from scratch
+        beginEvent();
+    }
+};
+
+static inline ScriptEngineData* engineData(lua_State* l)
+{
+    return *static_cast<ScriptEngineData**>(lua_getextraspace(l));
+}
+
+static void instructionHook(lua_State* l, lua_Debug*)
+{
+    ScriptEngineData* data = engineData(l);
+    if (!data->active)
+        return;
+    data->active->instructions += HookGranularity;
+    data->eventInstructions += HookGranularity;
+    if (data->budget && data->eventInstructions > data->budget) {
+        // keep raising until the handler unwinds, even if it pcalls
+        data->budgetExceeded = true;
+        luaL_error(l, "instruction budget of %llu exceeded", static_cast<unsigned long long>(data->budget));
+    }
+}
+
+static inline void pushStats(lua_State* l, const char* kind, size_t index, const HandlerStats& stats)
+{
+    lua_createtable(l, 0, 7);
+    lua_pushstring(l, kind);
+    lua_setfield(l, -2, "kind");
+    lua_pushinteger(l, index + 1);
+    lua_setfield(l, -2, "index");
+    lua_pushinteger(l, stats.invocations);
+    lua_setfield(l, -2, "invocations");
+    lua_pushinteger(l, stats.totalTime);
+    lua_setfield(l, -2, "totalTime");
+    lua_pushinteger(l, stats.maxTime);
+    lua_setfield(l, -2, "maxTime");
+    lua_pushinteger(l, stats.instructions);
+    lua_setfield(l, -2, "instructions");
+    lua_pushinteger(l, stats.aborted);
+    lua_setfield(l, -2, "aborted");
+}
+
+static int profilerStats(lua_State* l)
+{
+    ScriptEngineData* data = engineData(l);
+    lua_createtable(l, data->mouseEventFunctions.size() + data->keyEventFunctions.size() + 1, 0);
+    lua_Integer idx = 1;
+    for (size_t i = 0; i < data->mouseEventFunctions.size(); ++i) {
+        pushStats(l, "mouse", i, data->mouseEventFunctions[i].stats);
+        lua_rawseti(l, -2, idx++);
+    }
+    for (size_t i = 0; i < data->keyEventFunctions.size(); ++i) {
+        pushStats(l, "key", i, data->keyEventFunctions[i].stats);
+        lua_rawseti(l, -2, idx++);
+    }
+    pushStats(l, "coroutines", 0, data->coroutineStats);
+    lua_rawseti(l, -2, idx++);
+    return 1;
+}
+
+static int profilerReset(lua_State* l)
+{
+    ScriptEngineData* data = engineData(l);
+    for (auto& handler : data->mouseEventFunctions)
+        handler.stats = HandlerStats();
+    for (auto& handler : data->keyEventFunctions)
+        handler.stats = HandlerStats();
+    data->coroutineStats = HandlerStats();
+    return 0;
+}
+
+static int profilerSetBudget(lua_State* l)
+{
+    const lua_Integer budget = luaL_checkinteger(l, 1);
+    engineData(l)->budget = budget > 0 ? budget : 0;
+    return 0;
+}
+
+static int profilerBudget(lua_State* l)
+{
+    lua_pushinteger(l, engineData(l)->budget);
+    return 1;
+}
+
+static int panic(lua_State* l)
+{
+    printf("unprotected lua error: %s\n", lua_tostring(l, -1));
+    return 0;
+}
+
+static inline std::unique_ptr<sel::State> createState(LuaAllocator* allocator)
+{
+    lua_State* l = lua_newstate(LuaAllocator::alloc, allocator);
+    lua_atpanic(l, panic);
+    luaL_openlibs(l);
+    return std::make_unique<sel::State>(l);
+}
+
+static int gcStats(lua_State* l)
+{
+    const GcStats& gc = engineData(l)->gc;
+    lua_createtable(l, 0, 5);
+    lua_pushinteger(l, gc.slices);
+    lua_setfield(l, -2, "slices");
+    lua_pushinteger(l, gc.cycles);
+    lua_setfield(l, -2, "cycles");
+    lua_pushinteger(l, gc.totalTime);
+    lua_setfield(l, -2, "totalTime");
+    lua_pushinteger(l, gc.lastSlice);
+    lua_setfield(l, -2, "lastSlice");
+    lua_pushinteger(l, gc.maxSlice);
+    lua_setfield(l, -2, "maxSlice");
+    return 1;
+}
+
+static int gcSetSliceBudget(lua_State* l)
+{
+    const lua_Integer us = luaL_checkinteger(l, 1);
+    engineData(l)->gcSliceBudget = us > 0 ? us * 1000 : 0;
+    return 0;
+}
+
+static int memoryStats(lua_State* l)
+{
+    void* ud;
+    lua_getallocf(l, &ud);
+    const LuaAllocator::Stats& stats = static_cast<LuaAllocator*>(ud)->stats();
+    lua_createtable(l, 0, 4);
+    lua_pushinteger(l, stats.bytes);
+    lua_setfield(l, -2, "bytes");
+    lua_pushinteger(l, stats.allocations);
+    lua_setfield(l, -2, "allocations");
+    lua_pushinteger(l, stats.totalAllocations);
+    lua_setfield(l, -2, "totalAllocations");
+    lua_pushinteger(l, stats.arenaBytes);
+    lua_setfield(l, -2, "arenaBytes");
+    return 1;
+}
+
+// an encoded event, either a compact record or a finished flatbuffer
+struct Message
+{
+    int type;
+    const uint8_t* data;
+    size_t size;
+};
+
+template<typename Record>
+static inline Message recordMessage(int type, const Record& record)
+{
+    return { type, reinterpret_cast<const uint8_t*>(&record), sizeof(Record) };
+}
+
+static inline Message encoderMessage(int type, const FlatbufferEncoder& encoder)
+{
+    return { type, encoder.data(), encoder.size() };
+}
+
+template<typename T>
+struct EventTraits;
+
+template<>
+struct EventTraits<MouseEvent>
+{
+    typedef Disseminate::Compact::MouseRecord Record;
+    enum { TableType = Disseminate::FlatbufferTypes::MouseEvent,
+           CompactType = Disseminate::FlatbufferTypes::CompactMouseEvent };
+
+    static MouseEvent& check(lua_State* l, int idx) { return EventBindings::checkMouseEvent(l, idx); }
+    static std::deque<Handler<LuaFunction> >& handlers(ScriptEngineData* data) { return data->mouseEventFunctions; }
+
+    static bool toRecord(MouseEvent& event, uint16_t sender, Record& record)
+    {
+        const Disseminate::Mouse::EventT* flat = event.flat();
+        if (!sender || flat->modifiers > UINT32_MAX || flat->clickCount < 0 || flat->clickCount > UINT8_MAX)
+            return false;
+        memset(&record, 0, sizeof(record));
+        record.timestamp = flat->timestamp;
+        if (flat->location) {
+            record.x = flat->location->x();
+            record.y = flat->location->y();
+            record.flags |= Disseminate::Compact::HasLocation;
+        }
+        if (flat->delta) {
+            record.deltaX = flat->delta->x();
+            record.deltaY = flat->delta->y();
+            record.flags |= Disseminate::Compact::HasDelta;
+        }
+        record.pressure = flat->pressure;
+        record.modifiers = flat->modifiers;
+        record.sender = sender;
+        record.type = flat->type;
+        record.button = flat->button;
+        record.clickCount = flat->clickCount;
+        return true;
+    }
+
+    static Message encodeTable(const std::string& from, MouseEvent& event, FlatbufferEncoder& encoder)
+    {
+        auto flat = event.flat();
+        flat->fromUuid = from;
+        encoder.finish(Disseminate::Mouse::CreateEvent(encoder.builder(), flat));
+        return encoderMessage(TableType, encoder);
+    }
+
+    static int remap(const ScriptEngineData*, uint32_t, MouseEvent&, const Message&, std::vector<uint8_t>&)
+    {
+        return 0;
+    }
+};
+
+template<>
+struct EventTraits<KeyEvent>
+{
+    typedef Disseminate::Compact::KeyRecord Record;
+    enum { TableType = Disseminate::FlatbufferTypes::KeyEvent,
+           CompactType = Disseminate::FlatbufferTypes::CompactKeyEvent };
+
+    static KeyEvent& check(lua_State* l, int idx) { return EventBindings::checkKeyEvent(l, idx); }
+    static std::deque<Handler<LuaFunction> >& handlers(ScriptEngineData* data) { return data->keyEventFunctions; }
+
+    static bool fits(int64_t keyCode, uint64_t modifiers)
+    {
+        return keyCode >= 0 && keyCode <= UINT16_MAX && modifiers <= UINT32_MAX;
+    }
+
+    static bool toRecord(KeyEvent& event, uint16_t sender, Record& record)
+    {
+        const Disseminate::Key::EventT* flat = event.flat();
+        if (!sender || !fits(flat->keyCode, flat->modifiers) || flat->text.size() > Disseminate::Compact::MaxText)
+            return false;
+        memset(&record, 0, sizeof(record));
+        record.timestamp = flat->timestamp;
+        if (flat->location) {
+            record.x = flat->location->x();
+            record.y = flat->location->y();
+            record.flags |= Disseminate::Compact::HasLocation;
+        }
+        if (flat->repeat)
+            record.flags |= Disseminate::Compact::Repeat;
+        record.modifiers = flat->modifiers;
+        record.keyCode = flat->keyCode;
+        record.sender = sender;
+        record.type = flat->type;
+        record.textLength = flat->text.size();
+        memcpy(record.text, flat->text.data(), flat->text.size());
+        return true;
+    }
+
+    static Message encodeTable(const std::string& from, KeyEvent& event, FlatbufferEncoder& encoder)
+    {
+        // keep keyCode and modifiers in the buffer even when they're 0 so remap() can patch them
+        encoder.builder().ForceDefaults(true);
+        auto flat = event.flat();
+        flat->fromUuid = from;
+        encoder.finish(Disseminate::Key::CreateEvent(encoder.builder(), flat));
+        return encoderMessage(TableType, encoder);
+    }
+
+    // Produces the message for a destination that remaps this key and
+    // returns its type, or 0 if the destination doesn't remap it. The text
+    // is left alone, remaps are meant for keyCode driven input like hotbars.
+    static int remap(const ScriptEngineData* data, uint32_t handle, KeyEvent& event,
+                     const Message& message, std::vector<uint8_t>& remapped)
+    {
+        const SettingsSnapshot::RemapTable* table = data->remaps(handle);
+        if (!table)
+            return 0;
+        const SettingsSnapshot::Key* to = table->find({ event.keyCode(), event.modifiers() });
+        if (!to)
+            return 0;
+        if (message.type == CompactType) {
+            if (fits(to->code, to->modifiers)) {
+                Record record;
+                memcpy(&record, message.data, sizeof(record));
+                record.keyCode = to->code;
+                record.modifiers = to->modifiers;
+                const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+                remapped.assign(bytes, bytes + sizeof(record));
+                return message.type;
+            }
+            // the target doesn't fit a record, patch a table instead
+            FlatbufferEncoder encoder;
+            const Message table = encodeTable(data->uuid, event, encoder);
+            remapped.assign(table.data, table.data + table.size);
+        } else {
+            remapped.assign(message.data, message.data + message.size);
+        }
+        auto flat = Disseminate::Key::GetMutableEvent(&remapped[0]);
+        flat->mutate_keyCode(to->code);
+        flat->mutate_modifiers(to->modifiers);
+        return TableType;
+    }
+};
+
+// Encodes an event at most once per wire format, picking the format each
+// destination understands.
+template<typename T>
+class EventEncoder
+{
+public:
+    typedef EventTraits<T> Traits;
+
+    EventEncoder(const ScriptEngineData* d, T& e)
+        : data(d), event(e)
+    {
+        compact.type = table.type = 0;
+    }
+
+    const Message& operator()(uint32_t handle)
+    {
+        if (data->senderId && data->supports(handle, Disseminate::Protocol::CompactEvents)) {
+            if (!compact.type) {
+                if (Traits::toRecord(event, data->senderId, record))
+                    compact = recordMessage(Traits::CompactType, record);
+                else
+                    compact = tableMessage();
+            }
+            return compact;
+        }
+        return tableMessage();
+    }
+
+private:
+    const Message& tableMessage()
+    {
+        if (!table.type)
+            table = Traits::encodeTable(data->uuid, event, encoder);
+        return table;
+    }
+
+    const ScriptEngineData* data;
+    T& event;
+    FlatbufferEncoder encoder;
+    typename Traits::Record record;
+    Message compact, table;
+};
+
+static void countSend(ScriptEngineData* data, uint32_t handle, bool ok)
+{
+    if (ok) {
+        EngineMetrics::get().forwarded.add();
+        return;
+    }
+    Metrics::instance()->counter(Metrics::labeled("send_failures", "peer", data->names[handle])).add();
+    data->stall(handle);
+}
+
+// captured input is logged as the table it would go out as
+template<typename T>
+static void recordCaptured(const std::string& from, const T& event)
+{
+    if (EventLog::Writer* log = EventLog::recorder()) {
+        T copy(event);
+        FlatbufferEncoder encoder;
+        const Message message = EventTraits<T>::encodeTable(from, copy, encoder);
+        log->append(EventLog::Captured, message.type, message.data, message.size);
+    }
+}
+
+template<typename T>
+static int eventOn(lua_State* l)
+{
+    luaL_checktype(l, 1, LUA_TFUNCTION);
+    ScriptEngineData* data = engineData(l);
+    EventTraits<T>::handlers(data).emplace_back(LuaFunction(l, 1, &data->coroutines));
+    return 0;
+}
+
+template<typename T>
+static int eventSendToAll(lua_State* l)
+{
+    ScriptEngineData* data = engineData(l);
+    T& event = EventTraits<T>::check(l, 1);
+    // the message is the same for everyone that understands the same
+    // format, encode it once per format and patch a copy for destinations
+    // that remap it
+    EventEncoder<T> encode(data, event);
+    std::vector<uint8_t> remapped;
+    for (uint32_t handle = 0; handle < data->ports.size(); ++handle) {
+        const auto& port = data->ports[handle];
+        if (!port || !data->routed[handle])
+            continue;
+        const Message& message = encode(handle);
+        bool ok;
+        if (const int remappedType = EventTraits<T>::remap(data, handle, event, message, remapped))
+            ok = port->send(remappedType, remapped);
+        else
+            ok = port->send(message.type, message.data, message.size);
+        countSend(data, handle, ok);
+    }
+    return 0;
+}
+
+template<typename T>
+static int eventSendTo(lua_State* l)
+{
+    ScriptEngineData* data = engineData(l);
+    T& event = EventTraits<T>::check(l, 1);
+    uint32_t to;
+    if (lua_type(l, 2) == LUA_TNUMBER) {
+        to = data->resolve(luaL_checkinteger(l, 2));
+    } else {
+        // uuid, slow path kept for older scripts
+        size_t len;
+        const char* uuid = luaL_checklstring(l, 2, &len);
+        to = data->find(std::string(uuid, len));
+    }
+
+    const std::shared_ptr<HostPort>& port = data->port(to);
+    if (port && !data->reachable(to)) {
+        lua_pushboolean(l, false);
+        return 1;
+    }
+    if (!port) {
+        // boo
+        printf("invalid port %f %f - %u\n", event.x(), event.y(), to);
+        lua_pushboolean(l, false);
+        return 1;
+    }
+    EventEncoder<T> encode(data, event);
+    const Message& message = encode(to);
+    std::vector<uint8_t> remapped;
+    bool ok;
+    if (const int remappedType = EventTraits<T>::remap(data, to, event, message, remapped))
+        ok = port->send(remappedType, remapped);
+    else
+        ok = port->send(message.type, message.data, message.size);
+    countSend(data, to, ok);
+    lua_pushboolean(l, ok);
+    return 1;
+}
+
+template<typename T>
+static int eventInject(lua_State* l)
+{
+    const T& event = EventTraits<T>::check(l, 1);
+    engineData(l)->host->postEvent(std::make_shared<EventLoopEvent>(event));
+    EngineMetrics::get().injected.add();
+    return 0;
+}
+
+// pushes t[name] without invoking metamethods, so it can't raise
+static inline void rawField(lua_State* l, int idx, const char* name)
+{
+    lua_pushstring(l, name);
+    lua_rawget(l, idx < 0 ? idx - 1 : idx);
+}
+
+// sequence.start({ { delay = ms, event = ev }, ... }, onComplete)
+// The steps are converted to native events up front, lua is only
+// called again when the whole sequence has been posted.
+static int sequenceStart(lua_State* l)
+{
+    luaL_checktype(l, 1, LUA_TTABLE);
+    if (!lua_isnoneornil(l, 2))
+        luaL_checktype(l, 2, LUA_TFUNCTION);
+
+    // luaL_error doesn't return, check every step before anything
+    // native exists that it would skip the destructor of
+    const lua_Integer count = luaL_len(l, 1);
+    for (lua_Integer i = 1; i <= count; ++i) {
+        lua_rawgeti(l, 1, i);
+        if (!lua_istable(l, -1))
+            return luaL_error(l, "sequence step %d is not a table", static_cast<int>(i));
+        rawField(l, -1, "event");
+        if (!EventBindings::toKeyEvent(l, -1) && !EventBindings::toMouseEvent(l, -1))
+            return luaL_error(l, "sequence step %d has no event", static_cast<int>(i));
+        lua_pop(l, 2);
+    }
+
+    std::vector<Sequencer::Step> steps;
+    steps.reserve(count);
+    for (lua_Integer i = 1; i <= count; ++i) {
+        lua_rawgeti(l, 1, i);
+        rawField(l, -1, "delay");
+        const lua_Integer delay = lua_tointeger(l, -1);
+        rawField(l, -2, "event");
+
+        Sequencer::Step step;
+        step.delay = delay > 0 ? delay : 0;
+        if (const KeyEvent* key = EventBindings::toKeyEvent(l, -1))
+            step.event = std::make_shared<EventLoopEvent>(*key);
+        else
+            step.event = std::make_shared<EventLoopEvent>(*EventBindings::toMouseEvent(l, -1));
+        steps.push_back(std::move(step));
+        lua_pop(l, 3);
+    }
+
+    Sequencer::DoneCallback done;
+    if (!lua_isnoneornil(l, 2)) {
+        // std::function wants something copyable
+        std::shared_ptr<LuaFunction> function = std::make_shared<LuaFunction>(l, 2);
+        done = [function](uint32_t id, bool completed) {
+            if (completed)
+                (*function)(id);
+        };
+    }
+    lua_pushinteger(l, engineData(l)->sequencer.start(std::move(steps), done));
+    return 1;
+}
+
+static int sequenceCancel(lua_State* l)
+{
+    const lua_Integer id = luaL_checkinteger(l, 1);
+    lua_pushboolean(l, engineData(l)->sequencer.cancel(id));
+    return 1;
+}
+
+template<typename T>
+static void registerEventFunctions(lua_State* l, const char* name)
+{
+    const luaL_Reg functions[] = {
+        { "on", eventOn<T> },
+        { "sendToAll", eventSendToAll<T> },
+        { "sendTo", eventSendTo<T> },
+        { "inject", eventInject<T> },
+        { 0, 0 }
+    };
+    luaL_newlib(l, functions);
+    lua_setglobal(l, name);
+}
+
+static inline void setEnum(sel::State& state, const std::string& name, int c)
+{
+    state["enums"][name] = c;
+}
+
+ScriptEngine::ScriptEngine(const std::string& uuid, Host* host)
+    : allocator(std::make_unique<LuaAllocator>()),
+      state(createState(allocator.get())),
+      data(std::make_unique<ScriptEngineData>(uuid, host))
+{
+    state->HandleExceptionsPrintingToStdOut();
+
+    {
+        lua_State* l = *state;
+        *static_cast<ScriptEngineData**>(lua_getextraspace(l)) = data.get();
+        lua_sethook(l, instructionHook, LUA_MASKCOUNT, HookGranularity);
+        // we drive the collector ourselves, see idle()
+        lua_gc(l, LUA_GCSTOP, 0);
+
+        const luaL_Reg profiler[] = {
+            { "stats", profilerStats },
+            { "reset", profilerReset },
+            { "setBudget", profilerSetBudget },
+            { "budget", profilerBudget },
+            { "memory", memoryStats },
+            { "gc", gcStats },
+            { "setGcSliceBudget", gcSetSliceBudget },
+            { 0, 0 }
+        };
+        luaL_newlib(l, profiler);
+        lua_setglobal(l, "profiler");
+
+        const luaL_Reg sequence[] = {
+            { "start", sequenceStart },
+            { "cancel", sequenceCancel },
+            { 0, 0 }
+        };
+        luaL_newlib(l, sequence);
+        lua_setglobal(l, "sequence");
+
+        data->coroutines.registerBindings(l);
+        ScriptEngineData* engine = data.get();
+        data->coroutines.setResumeScope([engine](bool resuming) { engine->resumeScope(resuming); });
+
+        EventBindings::registerTypes(l);
+        registerEventFunctions<MouseEvent>(l, "mouseEvent");
+        registerEventFunctions<KeyEvent>(l, "keyEvent");
+        SettingsSnapshot::registerBindings(l, &data->settings);
+    }
+
+    (*state)["uuid"] = [this]() {
+        return data->uuid;
+    };
+
+    setEnum(*state, "MouseMove", Disseminate::Mouse::Type_Move);
+    setEnum(*state, "MousePress", Disseminate::Mouse::Type_Press);
+    setEnum(*state, "MouseRelease", Disseminate::Mouse::Type_Release);
+    setEnum(*state, "MouseButtonNone", Disseminate::Mouse::Button_None);
+    setEnum(*state, "MouseButtonLeft", Disseminate::Mouse::Button_Left);
+    setEnum(*state, "MouseButtonMiddle", Disseminate::Mouse::Button_Middle);
+    setEnum(*state, "MouseButtonRight", Disseminate::Mouse::Button_Right);
+    setEnum(*state, "KeyUp", Disseminate::Key::Type_Up);
+    setEnum(*state, "KeyDown", Disseminate::Key::Type_Down);
+    setEnum(*state, "Add", enums::Add);
+    setEnum(*state, "Remove", enums::Remove);
+    setEnum(*state, "Local", ScriptEngine::Local);
+    setEnum(*state, "Remote", ScriptEngine::Remote);
+    setEnum(*state, "WhiteList", Disseminate::Settings::Type_WhiteList);
+    setEnum(*state, "BlackList", Disseminate::Settings::Type_BlackList);
+
+    {
+        auto clients = (*state)["clients"];
+        clients["size"] = [this]() -> int {
+            return data->clients.size();
+        };
+        clients["type"] = [this](int pos) -> int {
+            return data->clients.at(pos).type;
+        };
+        clients["name"] = [this](int pos) {
+            return data->clients.at(pos).uuid;
+        };
+        clients["handle"] = [this](int pos) -> int {
+            return data->scriptHandle(data->clients.at(pos).handle);
+        };
+        clients["on"] = [this](sel::function<void(int, int, const std::string&, int)> fun) {
+            data->clientChangeFunctions.push_back(fun);
+        };
+    }
+
+    {
+        auto timers = (*state)["timers"];
+        timers["startTimeout"] = [this](sel::function<void()> cb, uint32_t when) -> int {
+            auto next = data->nextTimer++;
+            auto timer = data->host->makeTimer();
+            timer->onTimeout([this, next, cb]() mutable {
+                    {
+                        sel::HandlerScope scope(state->GetExceptionHandler());
+                        cb();
+                    }
+
+                    auto timer = data->timers.find(next);
+                    if (timer == data->timers.end())
+                        return;
+                    timer->second->stop();
+                    data->timers.erase(timer);
+                });
+            timer->start(when, EventLoopTimer::Timeout);
+            data->timers[next] = timer;
+            return next;
+        };
+        timers["startInterval"] = [this](sel::function<void()> cb, uint32_t when) -> int {
+            auto next = data->nextTimer++;
+            auto timer = data->host->makeTimer();
+            timer->onTimeout([this, next, cb]() mutable {
+                    sel::HandlerScope scope(state->GetExceptionHandler());
+                    cb();
+                });
+            timer->start(when, EventLoopTimer::Interval);
+            data->timers[next] = timer;
+            return next;
+        };
+        timers["stop"] = [this](uint32_t id) -> bool {
+            auto timer = data->timers.find(id);
+            if (timer == data->timers.end())
+                return false;
+            const bool ok = timer->second->stop();
+            data->timers.erase(timer);
+            return ok;
+        };
+    }
+
+    (*state)["logString"] = [](const std::string& str) {
+        printf("logString -- '%s'\n", str.c_str());
+    };
+    (*state)["logInt"] = [](int i) {
+        printf("logInt -- %d\n", i);
+    };
+#if 1
+    (*state)("capturingMouse = 0\n"
+             "function acceptKeys(type, ke)\n"
+             "  if type == enums.Remote then\n"
+             "    keyEvent.inject(ke)\n"
+             "    return true\n"
+             "  end\n"
+             "  local code = ke:keycode()\n"
+             "  local mods = ke:modifiers()\n"
+             "  if settings:isMouseBind(code, mods) then\n"
+             "    if ke:type() == enums.KeyDown then\n"
+             "      if capturingMouse == 0 then\n"
+             "        capturingMouse = 1\n"
+             "      else\n"
+             "        capturingMouse = 0\n"
+             "      end\n"
+             "    end\n"
+             "    return false\n"
+             "  end\n"
+             "  if settings:isWhitelisted(code, mods) then\n"
+             "    keyEvent.sendToAll(ke)\n"
+             "  end\n"
+             "  if settings:isExcluded(code, mods) then\n"
+             "    return false\n"
+             "  end\n"
+             "  return true\n"
+             "end\n"
+             "function acceptMouse(type, me)\n"
+             "  if type == enums.Remote then\n"
+             "    mouseEvent.inject(me)\n"
+             "    return true\n"
+             "  end\n"
+             "  if capturingMouse == 0 then\n"
+             "    return true\n"
+             "  end\n"
+             "  mouseEvent.sendToAll(me)\n"
+             "  return true\n"
+             "end\n"
+             "mouseEvent.on(acceptMouse)\n"
+             "keyEvent.on(acceptKeys)\n");
+#endif
+#if 0
+    (*state)("local foobar\n"
+             "function acceptMouseEvent(type, me)\n"
+             "  if me:x() > 380 then\n"
+             "    logInt(776)\n"
+             "    logInt(me:type())\n"
+             "    if me:type() == enums.MouseRelease then\n"
+             "      local move = MouseEvent.new(enums.MouseMove, enums.MouseButtonNone, 502.386719, 155.292969)\n"
+             "      mouseEvent.inject(move)\n"
+             "      local press = MouseEvent.new(enums.MousePress, enums.MouseButtonLeft, 502.386719, 155.292969)\n"
+             "      mouseEvent.inject(press)\n"
+             "      local release = MouseEvent.new(enums.MouseRelease, enums.MouseButtonLeft, 502.386719, 155.292969)\n"
+             "      mouseEvent.inject(release)\n"
+             "      logInt(777)\n"
+             "    end\n"
+             "    return false"
+             "  end\n"
+             "  mouseEvent.sendTo(me, \"abc\")\n"
+             "  mouseEvent.sendTo(foobar, \"1ghi\")\n"
+             "  foobar:set_x(200)\n"
+             "  mouseEvent.sendTo(foobar, \"2ghi\")\n"
+             "  return true\n"
+             "end\n"
+             "function acceptOtherMouseEvent(type, me)\n"
+             // "  me:set_x(100)\n"
+             // "  mouseEvent.sendTo(me, \"def\")\n"
+             // "  foobar = me\n"
+             // "  local brandnew = MouseEvent.new(enums.MousePress, enums.MouseButtonLeft, 99, 55.77)\n"
+             // "  brandnew:set_x(199)\n"
+             // "  mouseEvent.sendTo(brandnew, \"brandnew\")\n"
+             "  local me2 = me:clone()\n"
+             "  local str1 = \"abchey\"\n"
+             "  local str2 = str1\n"
+             "  mouseEvent.sendTo(me2, str1)\n"
+             "  me:set_x(100)\n"
+             "  str1 = \"321\"\n"
+             "  mouseEvent.sendTo(me, str1)\n"
+             "  mouseEvent.sendTo(me2, str2)\n"
+             "  logInt(530)\n"
+             "  return true\n"
+             "end\n"
+             "local blockedKeys = 0\n"
+             "function acceptKeyEvent(type, ke)\n"
+             "  logString(\"key!!\")\n"
+             "  logInt(ke:keycode())\n"
+             "  if blockedKeys < 2 then\n"
+             "    blockedKeys = blockedKeys + 1\n"
+             "    return false\n"
+             "  end\n"
+             "  return true\n"
+             "end\n"
+             "function clientChange(change, type, client)\n"
+             "  logString(client)\n"
+             "  logInt(change)\n"
+             "  logInt(type)\n"
+             "  logInt(clients.size())\n"
+             "  logString(clients.name(0))\n"
+             "end\n"
+             "local timeoutCnt = 0\n"
+             "local timeoutId\n"
+             "function onTimeout()\n"
+             "  timeoutCnt = timeoutCnt + 1\n"
+             "  if timeoutCnt > 3 then\n"
+             "    logString(\"stopping\")\n"
+             "    timers.stop(timeoutId)\n"
+             "    local keyPress = KeyEvent.new(enums.KeyUp, 0, 0, 0)\n"
+             "    keyPress:set_text(\"a\")\n"
+             "    keyEvent.inject(keyPress)\n"
+             "  end\n"
+             "  logString(\"timeout\")"
+             "end\n"
+             "timeoutId = timers.startInterval(onTimeout, 2000)\n"
+             "logInt(enums.MouseMove)\n"
+             "logInt(clients.size())\n"
+             "clients.on(clientChange)\n"
+             "keyEvent.on(acceptKeyEvent)\n"
+             "mouseEvent.on(acceptOtherMouseEvent)\n"
+             //"mouseEvent.on(acceptMouseEvent)\n"
+        );
+#endif
+}
+
+ScriptEngine::~ScriptEngine()
+{
+    // the state doesn't own the lua_State since we created it with our allocator,
+    // release all references into it before closing
+    lua_State* l = *state;
+    data.reset();
+    state.reset();
+    lua_close(l);
+}
+
+void ScriptEngine::registerClient(ClientType type, std::unique_ptr<Disseminate::RemoteAdd::EventT>& eventData)
+{
+    if (eventData->id)
+        data->setSender(eventData->id, eventData->uuid);
+    // known before the clientChange callbacks run so they can send right away
+    data->capabilities[data->intern(eventData->uuid)] = eventData->version >= 1 ? eventData->capabilities : 0;
+    registerClient(type, eventData->uuid);
+}
+
+void ScriptEngine::setSenderId(uint16_t id)
+{
+    data->senderId = id;
+}
+
+const std::string& ScriptEngine::uuid() const
+{
+    return data->uuid;
+}
+
+void ScriptEngine::setPeerState(const std::string& uuid, bool degraded)
+{
+    const uint32_t handle = data->find(uuid);
+    if (handle >= data->ports.size())
+        return;
+    // the controller's word replaces our own guess
+    data->degraded[handle] = degraded;
+    data->stalled[handle] = 0;
+    data->routed[handle] = data->routes(handle);
+}
+
+void ScriptEngine::registerClient(ClientType type, const std::string& uuid)
+{
+    const uint32_t handle = data->intern(uuid);
+    data->retain(handle);
+    data->clients.push_back({ type, uuid, handle });
+    if (type == Remote)
+        data->makePort(handle, uuid);
+
+    sel::HandlerScope scope(state->GetExceptionHandler());
+
+    auto on = data->clientChangeFunctions.begin();
+    const auto end = data->clientChangeFunctions.end();
+    while (on != end) {
+        (*on)(enums::Add, type, uuid, data->scriptHandle(handle));
+        ++on;
+    }
+}
+
+void ScriptEngine::unregisterClient(ClientType type, const std::string& uuid)
+{
+    const uint32_t handle = data->find(uuid);
+    {
+        auto client = data->clients.begin();
+        const auto end = data->clients.end();
+        while (client != end) {
+            if (client->type == type && client->uuid == uuid)
+                break;
+            ++client;
+        }
+        if (client == end)
+            return;
+        if (type == Remote)
+            data->removePort(handle);
+        data->clients.erase(client);
+        data->release(handle);
+    }
+
+    sel::HandlerScope scope(state->GetExceptionHandler());
+
+    auto on = data->clientChangeFunctions.begin();
+    const auto end = data->clientChangeFunctions.end();
+    while (on != end) {
+        (*on)(enums::Remove, type, uuid, data->scriptHandle(handle));
+        ++on;
+    }
+}
+
+void ScriptEngine::clearClients(ClientType type)
+{
+    std::vector<ScriptEngineData::Client> removed;
+
+    {
+        auto client = data->clients.begin();
+        while (client != data->clients.end()) {
+            if (client->type == type) {
+                removed.push_back(*client);
+                if (type == Remote)
+                    data->removePort(client->handle);
+                data->release(client->handle);
+                client = data->clients.erase(client);
+            } else {
+                ++client;
+            }
+        }
+    }
+
+    sel::HandlerScope scope(state->GetExceptionHandler());
+
+    auto on = data->clientChangeFunctions.begin();
+    const auto end = data->clientChangeFunctions.end();
+    while (on != end) {
+        for (const auto& client : removed) {
+            (*on)(enums::Remove, type, client.uuid, data->scriptHandle(client.handle));
+        }
+        ++on;
+    }
+}
+
+void ScriptEngine::collectStats(Disseminate::ScriptStats::StatsT& stats) const
+{
+    auto add = [&stats](Disseminate::ScriptStats::Kind kind, size_t index, const HandlerStats& s) {
+        auto handler = std::make_unique<Disseminate::ScriptStats::HandlerT>();
+        handler->kind = kind;
+        handler->index = index;
+        handler->invocations = s.invocations;
+        handler->totalTime = s.totalTime;
+        handler->maxTime = s.maxTime;
+        handler->instructions = s.instructions;
+        handler->aborted = s.aborted;
+        stats.handlers.push_back(std::move(handler));
+    };
+
+    stats.uuid = data->uuid;
+    stats.budget = data->budget;
+    stats.memoryBytes = allocator->stats().bytes;
+    stats.memoryAllocations = allocator->stats().allocations;
+    stats.gcSlices = data->gc.slices;
+    stats.gcTime = data->gc.totalTime;
+    stats.gcMaxSlice = data->gc.maxSlice;
+    for (size_t i = 0; i < data->mouseEventFunctions.size(); ++i)
+        add(Disseminate::ScriptStats::Kind_Mouse, i, data->mouseEventFunctions[i].stats);
+    for (size_t i = 0; i < data->keyEventFunctions.size(); ++i)
+        add(Disseminate::ScriptStats::Kind_Key, i, data->keyEventFunctions[i].stats);
+}
+
+void ScriptEngine::idle()
+{
+    const LuaAllocator::Stats& mem = allocator->stats();
+    if (!data->gcPending && mem.totalAllocations == data->gcAllocations)
+        return;
+
+    lua_State* l = *state;
+    const uint64_t start = data->host->now();
+    const uint64_t deadline = start + data->gcSliceBudget;
+    bool done;
+    uint64_t now;
+    do {
+        // LUA_GCSTEP works even though the collector is stopped
+        done = lua_gc(l, LUA_GCSTEP, 0) != 0;
+        now = data->host->now();
+    } while (!done && now < deadline);
+
+    GcStats& gc = data->gc;
+    const uint64_t elapsed = now - start;
+    ++gc.slices;
+    gc.totalTime += elapsed;
+    gc.lastSlice = elapsed;
+    if (elapsed > gc.maxSlice)
+        gc.maxSlice = elapsed;
+
+    data->gcPending = !done;
+    if (done) {
+        ++gc.cycles;
+        data->gcAllocations = mem.totalAllocations;
+        data->gcBaseline = mem.bytes;
+    }
+}
+
+void ScriptEngine::collectIfOverdue()
+{
+    // an app that never blocks in its event loop never goes idle,
+    // don't let the heap grow without bounds in that case
+    enum { MinimumCeiling = 8 * 1024 * 1024 };
+    const uint64_t ceiling = std::max<uint64_t>(data->gcBaseline * 4, MinimumCeiling);
+    if (allocator->stats().bytes > ceiling)
+        idle();
+}
+
+class DispatchScope
+{
+public:
+    DispatchScope(ScriptEngine* e)
+        : engine(e)
+    {
+    }
+    ~DispatchScope()
+    {
+        engine->collectIfOverdue();
+    }
+
+private:
+    ScriptEngine* engine;
+};
+
+void ScriptEngine::processRemoteMouseEvent(std::unique_ptr<Disseminate::Mouse::EventT>& eventData)
+{
+    DispatchScope dispatch(this);
+
+    const MouseEvent event(eventData);
+    EngineMetrics::get().received.add();
+    data->beginEvent();
+    auto& handlers = data->mouseEventFunctions;
+    for (size_t i = 0; i < handlers.size(); ++i) {
+        if (!data->call(handlers[i], Remote, event))
+            return;
+        if (data->budgetExceeded) {
+            EngineMetrics::get().dropped.add();
+            return;
+        }
+    }
+}
+
+void ScriptEngine::processRemoteKeyEvent(std::unique_ptr<Disseminate::Key::EventT>& eventData)
+{
+    DispatchScope dispatch(this);
+
+    const KeyEvent event(eventData);
+    EngineMetrics::get().received.add();
+    data->coroutines.keyEvent(Remote, event);
+    data->beginEvent();
+    auto& handlers = data->keyEventFunctions;
+    for (size_t i = 0; i < handlers.size(); ++i) {
+        if (!data->call(handlers[i], Remote, event))
+            return;
+        if (data->budgetExceeded) {
+            EngineMetrics::get().dropped.add();
+            return;
+        }
+    }
+}
+
+void ScriptEngine::processRemoteMouseEvent(const Disseminate::Compact::MouseRecord& record)
+{
+    std::unique_ptr<Disseminate::Mouse::EventT> event = std::make_unique<Disseminate::Mouse::EventT>();
+    event->type = static_cast<Disseminate::Mouse::Type>(record.type);
+    event->button = static_cast<Disseminate::Mouse::Button>(record.button);
+    if (record.flags & Disseminate::Compact::HasLocation)
+        event->location = std::make_unique<Disseminate::Mouse::Location>(record.x, record.y);
+    if (record.flags & Disseminate::Compact::HasDelta)
+        event->delta = std::make_unique<Disseminate::Mouse::Location>(record.deltaX, record.deltaY);
+    event->modifiers = record.modifiers;
+    event->timestamp = record.timestamp;
+    event->clickCount = record.clickCount;
+    event->pressure = record.pressure;
+    event->fromUuid = data->sender(record.sender);
+    processRemoteMouseEvent(event);
+}
+
+void ScriptEngine::processRemoteKeyEvent(const Disseminate::Compact::KeyRecord& record)
+{
+    std::unique_ptr<Disseminate::Key::EventT> event = std::make_unique<Disseminate::Key::EventT>();
+    event->type = static_cast<Disseminate::Key::Type>(record.type);
+    event->keyCode = record.keyCode;
+    if (record.flags & Disseminate::Compact::HasLocation)
+        event->location = std::make_unique<Disseminate::Key::Location>(record.x, record.y);
+    event->modifiers = record.modifiers;
+    event->timestamp = record.timestamp;
+    event->repeat = (record.flags & Disseminate::Compact::Repeat) != 0;
+    event->text.assign(record.text, std::min<size_t>(record.textLength, Disseminate::Compact::MaxText));
+    event->fromUuid = data->sender(record.sender);
+    processRemoteKeyEvent(event);
+}
+
+bool ScriptEngine::processLocalEvent(const std::shared_ptr<EventLoopEvent>& event)
+{
+    DispatchScope dispatch(this);
+
+    data->beginEvent();
+    if (event->mevt.isValid()) {
+        // each handler gets its own userdata, the event is copy-on-write
+        const MouseEvent& localEvent = event->mevt;
+        recordCaptured(data->uuid, localEvent);
+        EngineMetrics::get().captured.add();
+        auto& handlers = data->mouseEventFunctions;
+        for (size_t i = 0; i < handlers.size(); ++i) {
+            if (!data->call(handlers[i], Local, localEvent))
+                return false;
+            if (data->budgetExceeded) {
+                EngineMetrics::get().dropped.add();
+                break;
+            }
+        }
+    } else if (event->kevt.isValid()) {
+        const KeyEvent& localEvent = event->kevt;
+        recordCaptured(data->uuid, localEvent);
+        EngineMetrics::get().captured.add();
+        data->coroutines.keyEvent(Local, localEvent);
+        auto& handlers = data->keyEventFunctions;
+        for (size_t i = 0; i < handlers.size(); ++i) {
+            if (!data->call(handlers[i], Local, localEvent))
+                return false;
+            if (data->budgetExceeded) {
+                EngineMetrics::get().dropped.add();
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void ScriptEngine::processSettings(const Disseminate::Settings::Global* settings)
+{
+    // build outside of the swap so lua never sees a half made snapshot
+    data->setSettings(SettingsSnapshot::create(settings));
+}
@@ -7,23 +7,30 @@
 #include <KeyEvent_generated.h>
 #include <Settings_generated.h>
 #include <RemoteAdd_generated.h>
-#include <AppKit/NSEvent.h>
+#include <ScriptStats_generated.h>
+#include <CompactEvents.h>
 
 class ScriptEngineData;
 class EventLoopEvent;
+class Host;
+class LuaAllocator;
 
 class ScriptEngine
 {
 public:
-    ScriptEngine(const std::string& uuid);
+    // the host provides timers, the clock, event injection and ports,
+    // EventLoop in the app and SimulatedHost in tests
+    ScriptEngine(const std::string& uuid, Host* host);
     ~ScriptEngine();
 
     void evaluate(const std::string& code);
 
-    void processSettings(std::unique_ptr<Disseminate::Settings::GlobalT>& settings);
+    void processSettings(const Disseminate::Settings::Global* settings);
 
     void processRemoteMouseEvent(std::unique_ptr<Disseminate::Mouse::EventT>& eventData);
     void processRemoteKeyEvent(std::unique_ptr<Disseminate::Key::EventT>& eventData);
+    void processRemoteMouseEvent(const Disseminate::Compact::MouseRecord& record);
+    void processRemoteKeyEvent(const Disseminate::Compact::KeyRecord& record);
 
     bool processLocalEvent(const std::shared_ptr<EventLoopEvent>& event);
 
@@ -33,7 +40,24 @@ public:
     void unregisterClient(ClientType type, const std::string& uuid);
     void clearClients(ClientType type);
 
+    // the id the controller assigned us for compact events
+    void setSenderId(uint16_t id);
+    const std::string& uuid() const;
+
+    // a degraded peer stopped answering the controller's heartbeats,
+    // nothing is sent to it until it's healthy again
+    void setPeerState(const std::string& uuid, bool degraded);
+
+    void collectStats(Disseminate::ScriptStats::StatsT& stats) const;
+
+    // runs a bounded slice of garbage collection, the collector
+    // is otherwise stopped so it never runs while dispatching
+    void idle();
+    // collects if memory has grown too far without the loop going idle
+    void collectIfOverdue();
+
 private:
+    std::unique_ptr<LuaAllocator> allocator;
     std::unique_ptr<sel::State> state;
     std::unique_ptr<ScriptEngineData> data;
 };
@@ -0,0 +1,81 @@
+#include "Sequencer.h"
+#include "Host.h"
+
+Sequencer::Sequencer(Host* host)
+    : mHost(host), mNextId(0)
+{
+}
+
+Sequencer::~Sequencer()
+{
+    for (auto& sequence : mSequences) {
+        sequence.second.timer->stop();
+    }
+}
+
+uint32_t Sequencer::start(std::vector<Step>&& steps, const DoneCallback& done)
+{
+    const uint32_t id = mNextId++;
+    Sequence& sequence = mSequences[id];
+    sequence.steps = std::move(steps);
+    sequence.next = 0;
+    sequence.start = mHost->now();
+    sequence.done = done;
+
+    // turn the relative delays into offsets from the start
+    uint32_t offset = 0;
+    for (auto& step : sequence.steps) {
+        offset += step.delay;
+        step.delay = offset;
+    }
+
+    sequence.timer = mHost->makeTimer();
+    sequence.timer->onTimeout([this, id]() { advance(id, true); });
+
+    advance(id, false);
+    return id;
+}
+
+bool Sequencer::cancel(uint32_t id)
+{
+    auto it = mSequences.find(id);
+    if (it == mSequences.end())
+        return false;
+    it->second.timer->stop();
+    const DoneCallback done = std::move(it->second.done);
+    mSequences.erase(it);
+    if (done)
+        done(id, false);
+    return true;
+}
+
+void Sequencer::advance(uint32_t id, bool fromTimer)
+{
+    auto it = mSequences.find(id);
+    if (it == mSequences.end())
+        return;
+    Sequence& sequence = it->second;
+
+    const uint64_t elapsed = (mHost->now() - sequence.start) / 1000000;
+    while (sequence.next < sequence.steps.size() && sequence.steps[sequence.next].delay <= elapsed) {
+        mHost->postEvent(sequence.steps[sequence.next].event);
+        ++sequence.next;
+    }
+
+    if (sequence.next < sequence.steps.size()) {
+        sequence.timer->restart(sequence.steps[sequence.next].delay - elapsed);
+        return;
+    }
+
+    if (!fromTimer) {
+        // everything was posted right away, complete on the next loop
+        // iteration rather than from within start()
+        sequence.timer->start(0, EventLoopTimer::Timeout);
+        return;
+    }
+
+    const DoneCallback done = std::move(sequence.done);
+    mSequences.erase(it);
+    if (done)
+        done(id, true);
+}
@@ -0,0 +1,57 @@
+#ifndef SEQUENCER_H
+#define SEQUENCER_H
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class Host;
+class EventLoopEvent;
+class EventLoopTimer;
+
+// Plays back a list of prebuilt events with relative delays. Every
+// sequence owns a single EventLoopTimer that is restarted for each step,
+// steps are scheduled against the absolute start time so delays don't
+// accumulate drift.
+class Sequencer
+{
+public:
+    struct Step
+    {
+        uint32_t delay; // milliseconds after the previous step
+        std::shared_ptr<EventLoopEvent> event;
+    };
+
+    // completed is false if the sequence was cancelled
+    typedef std::function<void(uint32_t id, bool completed)> DoneCallback;
+
+    Sequencer(Host* host);
+    ~Sequencer();
+
+    uint32_t start(std::vector<Step>&& steps, const DoneCallback& done);
+    bool cancel(uint32_t id);
+
+    size_t size() const { return mSequences.size(); }
+
+private:
+    Sequencer(const Sequencer&) = delete;
+    Sequencer& operator=(const Sequencer&) = delete;
+
+    struct Sequence
+    {
+        std::vector<Step> steps; // delay holds the offset from start once started
+        size_t next;
+        uint64_t start; // nanoseconds
+        std::shared_ptr<EventLoopTimer> timer;
+        DoneCallback done;
+    };
+
+    void advance(uint32_t id, bool fromTimer);
+
+    Host* mHost;
+    uint32_t mNextId;
+    std::unordered_map<uint32_t, Sequence> mSequences;
+};
+
+#endif
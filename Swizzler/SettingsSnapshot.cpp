@@ -0,0 +1,237 @@
+#include "SettingsSnapshot.h"
+#include <new>
+
+static char sClientKey;
+
+template<typename T>
+static inline void insertKeys(SettingsSnapshot::KeySet& set, const T* keys)
+{
+    if (!keys)
+        return;
+    set.reserve(keys->size());
+    for (const auto* key : *keys) {
+        set.insert({ key->keyCode(), key->modifiers() });
+    }
+}
+
+static inline SettingsSnapshot::Key toKey(const Disseminate::Settings::Key* key)
+{
+    if (!key)
+        return { 0, 0 };
+    return { key->keyCode(), key->modifiers() };
+}
+
+SettingsSnapshot::SettingsSnapshot()
+{
+    mGlobal.type = Disseminate::Settings::Type_WhiteList;
+    mKeyBind = mMouseBind = { 0, 0 };
+}
+
+std::shared_ptr<const SettingsSnapshot> SettingsSnapshot::create(const Disseminate::Settings::Global* settings)
+{
+    std::shared_ptr<SettingsSnapshot> snapshot(new SettingsSnapshot);
+    snapshot->mGlobal.type = settings->type();
+    insertKeys(snapshot->mGlobal.keys, settings->keys());
+    insertKeys(snapshot->mExclusions, settings->activeExclusions());
+    snapshot->mKeyBind = toKey(settings->toggleKeyboard());
+    snapshot->mMouseBind = toKey(settings->toggleMouse());
+
+    if (const auto* specifics = settings->specifics()) {
+        for (const auto* specific : *specifics) {
+            if (!specific->uuid())
+                continue;
+            auto client = std::make_shared<Client>();
+            client->type = specific->type();
+            insertKeys(client->keys, specific->keys());
+            if (specific->group())
+                client->group = specific->group()->str();
+            if (const auto* remaps = specific->remaps()) {
+                auto& entries = client->remaps.mEntries;
+                entries.reserve(remaps->size());
+                for (const auto* remap : *remaps) {
+                    const Key from = { remap->from().keyCode(), remap->from().modifiers() };
+                    const Key to = { remap->to().keyCode(), remap->to().modifiers() };
+                    if (!from.isNull() && !to.isNull())
+                        entries.push_back(std::make_pair(from, to));
+                }
+                // stable so that the first remap for a given key wins
+                std::stable_sort(entries.begin(), entries.end(),
+                                 [](const RemapTable::Entry& a, const RemapTable::Entry& b) { return a.first < b.first; });
+                entries.erase(std::unique(entries.begin(), entries.end(),
+                                          [](const RemapTable::Entry& a, const RemapTable::Entry& b) { return a.first == b.first; }),
+                              entries.end());
+            }
+            snapshot->mClients[specific->uuid()->str()] = client;
+        }
+    }
+    return snapshot;
+}
+
+std::shared_ptr<const SettingsSnapshot::Client> SettingsSnapshot::forClient(const std::string& uuid) const
+{
+    auto it = mClients.find(uuid);
+    if (it != mClients.end())
+        return it->second;
+    return std::shared_ptr<const Client>();
+}
+
+// lua bindings
+
+typedef const std::shared_ptr<const SettingsSnapshot>* SettingsSlot;
+typedef std::shared_ptr<const SettingsSnapshot::Client> ClientRef;
+
+static inline const SettingsSnapshot* checkSettings(lua_State* l)
+{
+    SettingsSlot* slot = static_cast<SettingsSlot*>(luaL_checkudata(l, 1, "Disseminate.Settings"));
+    return (*slot)->get();
+}
+
+static inline const SettingsSnapshot::Client* checkClient(lua_State* l)
+{
+    return static_cast<ClientRef*>(luaL_checkudata(l, 1, "Disseminate.ClientSettings"))->get();
+}
+
+static inline SettingsSnapshot::Key checkKey(lua_State* l)
+{
+    return { luaL_checkinteger(l, 2), static_cast<uint64_t>(luaL_checkinteger(l, 3)) };
+}
+
+static int settingsType(lua_State* l)
+{
+    if (const SettingsSnapshot* settings = checkSettings(l))
+        lua_pushinteger(l, settings->global().type);
+    else
+        lua_pushnil(l);
+    return 1;
+}
+
+static int settingsContains(lua_State* l)
+{
+    const SettingsSnapshot* settings = checkSettings(l);
+    const SettingsSnapshot::Key key = checkKey(l);
+    lua_pushboolean(l, settings && settings->global().contains(key));
+    return 1;
+}
+
+static int settingsIsWhitelisted(lua_State* l)
+{
+    const SettingsSnapshot* settings = checkSettings(l);
+    const SettingsSnapshot::Key key = checkKey(l);
+    lua_pushboolean(l, settings && settings->isWhitelisted(key));
+    return 1;
+}
+
+static int settingsIsExcluded(lua_State* l)
+{
+    const SettingsSnapshot* settings = checkSettings(l);
+    const SettingsSnapshot::Key key = checkKey(l);
+    lua_pushboolean(l, settings && settings->isExcluded(key));
+    return 1;
+}
+
+static int settingsIsKeyBind(lua_State* l)
+{
+    const SettingsSnapshot* settings = checkSettings(l);
+    const SettingsSnapshot::Key key = checkKey(l);
+    lua_pushboolean(l, settings && settings->isKeyBind(key));
+    return 1;
+}
+
+static int settingsIsMouseBind(lua_State* l)
+{
+    const SettingsSnapshot* settings = checkSettings(l);
+    const SettingsSnapshot::Key key = checkKey(l);
+    lua_pushboolean(l, settings && settings->isMouseBind(key));
+    return 1;
+}
+
+static int settingsForClient(lua_State* l)
+{
+    const SettingsSnapshot* settings = checkSettings(l);
+    size_t len;
+    const char* uuid = luaL_checklstring(l, 2, &len);
+    if (!settings) {
+        lua_pushnil(l);
+        return 1;
+    }
+    ClientRef client = settings->forClient(std::string(uuid, len));
+    if (!client) {
+        lua_pushnil(l);
+        return 1;
+    }
+    // the client settings outlive a settings swap for as long as lua holds on to them
+    void* ud = lua_newuserdata(l, sizeof(ClientRef));
+    new (ud) ClientRef(std::move(client));
+    lua_rawgetp(l, LUA_REGISTRYINDEX, &sClientKey);
+    lua_setmetatable(l, -2);
+    return 1;
+}
+
+static int clientType(lua_State* l)
+{
+    lua_pushinteger(l, checkClient(l)->type);
+    return 1;
+}
+
+static int clientContains(lua_State* l)
+{
+    const SettingsSnapshot::Client* client = checkClient(l);
+    lua_pushboolean(l, client->contains(checkKey(l)));
+    return 1;
+}
+
+static int clientIsWhitelisted(lua_State* l)
+{
+    const SettingsSnapshot::Client* client = checkClient(l);
+    lua_pushboolean(l, client->isWhitelisted(checkKey(l)));
+    return 1;
+}
+
+static int clientGroup(lua_State* l)
+{
+    const SettingsSnapshot::Client* client = checkClient(l);
+    lua_pushlstring(l, client->group.c_str(), client->group.size());
+    return 1;
+}
+
+static int clientDestroy(lua_State* l)
+{
+    static_cast<ClientRef*>(lua_touserdata(l, 1))->~ClientRef();
+    return 0;
+}
+
+void SettingsSnapshot::registerBindings(lua_State* l, const std::shared_ptr<const SettingsSnapshot>* current)
+{
+    const luaL_Reg client[] = {
+        { "type", clientType },
+        { "contains", clientContains },
+        { "isWhitelisted", clientIsWhitelisted },
+        { "group", clientGroup },
+        { "__gc", clientDestroy },
+        { 0, 0 }
+    };
+    luaL_newmetatable(l, "Disseminate.ClientSettings");
+    luaL_setfuncs(l, client, 0);
+    lua_pushvalue(l, -1);
+    lua_setfield(l, -2, "__index");
+    lua_rawsetp(l, LUA_REGISTRYINDEX, &sClientKey);
+
+    const luaL_Reg settings[] = {
+        { "type", settingsType },
+        { "contains", settingsContains },
+        { "isWhitelisted", settingsIsWhitelisted },
+        { "isExcluded", settingsIsExcluded },
+        { "isKeyBind", settingsIsKeyBind },
+        { "isMouseBind", settingsIsMouseBind },
+        { "forClient", settingsForClient },
+        { 0, 0 }
+    };
+    void* ud = lua_newuserdata(l, sizeof(SettingsSlot));
+    *static_cast<SettingsSlot*>(ud) = current;
+    luaL_newmetatable(l, "Disseminate.Settings");
+    luaL_setfuncs(l, settings, 0);
+    lua_pushvalue(l, -1);
+    lua_setfield(l, -2, "__index");
+    lua_setmetatable(l, -2);
+    lua_setglobal(l, "settings");
+}
@@ -0,0 +1,106 @@
+#ifndef SETTINGSSNAPSHOT_H
+#define SETTINGSSNAPSHOT_H
+
+#include <Settings_generated.h>
+#include <lua.hpp>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Immutable view of a Settings::Global push. It's built once when the
+// settings arrive and is never modified afterwards, applying new settings
+// is a matter of swapping the shared_ptr the script engine holds.
+class SettingsSnapshot
+{
+public:
+    struct Key
+    {
+        int64_t code;
+        uint64_t modifiers;
+
+        bool operator==(const Key& other) const { return code == other.code && modifiers == other.modifiers; }
+        bool operator<(const Key& other) const
+        {
+            return code < other.code || (code == other.code && modifiers < other.modifiers);
+        }
+        bool isNull() const { return !code && !modifiers; }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            return std::hash<uint64_t>()((static_cast<uint64_t>(key.code) << 48) ^ key.modifiers);
+        }
+    };
+
+    typedef std::unordered_set<Key, KeyHash> KeySet;
+
+    // Key remaps for one destination, a flat vector sorted on the source
+    // key so a lookup is a binary search over contiguous memory.
+    class RemapTable
+    {
+    public:
+        bool empty() const { return mEntries.empty(); }
+
+        // returns the key to send instead of from, or nullptr if from isn't remapped
+        const Key* find(const Key& from) const
+        {
+            auto it = std::lower_bound(mEntries.begin(), mEntries.end(), from,
+                                       [](const Entry& entry, const Key& key) { return entry.first < key; });
+            if (it != mEntries.end() && it->first == from)
+                return &it->second;
+            return nullptr;
+        }
+
+    private:
+        typedef std::pair<Key, Key> Entry;
+        std::vector<Entry> mEntries;
+
+        friend class SettingsSnapshot;
+    };
+
+    struct Client
+    {
+        Disseminate::Settings::Type type;
+        KeySet keys;
+        RemapTable remaps;
+        std::string group;
+
+        bool contains(const Key& key) const { return keys.count(key) != 0; }
+        // whether the key passes the white or black list
+        bool isWhitelisted(const Key& key) const
+        {
+            return (type == Disseminate::Settings::Type_WhiteList) == contains(key);
+        }
+    };
+
+    static std::shared_ptr<const SettingsSnapshot> create(const Disseminate::Settings::Global* settings);
+
+    const Client& global() const { return mGlobal; }
+    std::shared_ptr<const Client> forClient(const std::string& uuid) const;
+
+    bool isWhitelisted(const Key& key) const { return mGlobal.isWhitelisted(key); }
+    bool isExcluded(const Key& key) const { return mExclusions.count(key) != 0; }
+    bool isKeyBind(const Key& key) const { return !mKeyBind.isNull() && mKeyBind == key; }
+    bool isMouseBind(const Key& key) const { return !mMouseBind.isNull() && mMouseBind == key; }
+
+    // Exposes the snapshot in current to lua as the global 'settings'.
+    // The userdata refers to the slot, not to a particular snapshot, so
+    // scripts always see the latest settings.
+    static void registerBindings(lua_State* l, const std::shared_ptr<const SettingsSnapshot>* current);
+
+private:
+    SettingsSnapshot();
+
+    Client mGlobal;
+    KeySet mExclusions;
+    Key mKeyBind, mMouseBind;
+    std::unordered_map<std::string, std::shared_ptr<const Client> > mClients;
+};
+
+#endif
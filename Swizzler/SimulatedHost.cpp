@@ -0,0 +1,164 @@
+#include "SimulatedHost.h"
+#include <algorithm>
+
+class SimulatedPort : public HostPort
+{
+public:
+    SimulatedPort(SimulatedHost* host, const std::string& name)
+        : mHost(host), mName(name)
+    {
+    }
+
+    bool send(int32_t id, const uint8_t* data, size_t size) override
+    {
+        if (mHost->mUnreachable.count(mName))
+            return false;
+        mHost->mSent.push_back({ mHost->mNow, mName, id, std::vector<uint8_t>(data, data + size) });
+        return true;
+    }
+
+private:
+    SimulatedHost* mHost;
+    std::string mName;
+};
+
+SimulatedHost::SimulatedHost(uint64_t start)
+    : mNow(start), mWakeups(0), mSerial(0)
+{
+}
+
+void SimulatedHost::postEvent(const std::shared_ptr<EventLoopEvent>& evt)
+{
+    mInjected.push_back({ mNow, evt });
+    wakeup();
+}
+
+std::shared_ptr<HostPort> SimulatedHost::connect(const std::string& name)
+{
+    return std::make_shared<SimulatedPort>(this, name);
+}
+
+void SimulatedHost::setReachable(const std::string& name, bool reachable)
+{
+    if (reachable)
+        mUnreachable.erase(name);
+    else
+        mUnreachable.insert(name);
+}
+
+void SimulatedHost::startTimer(uint32_t when, EventLoopTimer::Type type, const std::shared_ptr<EventLoopTimer>& timer)
+{
+    // a zero interval would keep firing without the clock ever moving
+    const uint64_t ms = (type == EventLoopTimer::Interval) ? std::max<uint32_t>(when, 1) : when;
+    const uint64_t at = mNow + ms * 1000000;
+    mTimers[at].push_back({ type, timer, ++mSerial });
+    due(timer.get()) = at;
+    timeout(timer.get()) = when;
+}
+
+bool SimulatedHost::stopTimer(const std::shared_ptr<EventLoopTimer>& timer)
+{
+    const auto bucket = mTimers.find(static_cast<uint64_t>(due(timer.get())));
+    if (bucket == mTimers.end())
+        return false;
+    auto& vec = bucket->second;
+    bool found = false;
+    auto t = vec.begin();
+    while (t != vec.end()) {
+        auto shared = t->timer.lock();
+        if (!shared) {
+            t = vec.erase(t);
+        } else if (shared == timer) {
+            vec.erase(t);
+            found = true;
+            break;
+        } else {
+            ++t;
+        }
+    }
+    if (vec.empty())
+        mTimers.erase(bucket);
+    return found;
+}
+
+size_t SimulatedHost::fireDue()
+{
+    // same rules as the real loop: call everything that's due, then drop
+    // those entries and put interval timers back. Timers started from a
+    // callback are kept even if they're due already, the real loop's
+    // clock has moved on by then and it leaves them for the next pass
+    const uint64_t last = mSerial;
+    size_t fired = 0;
+    {
+        std::vector<std::shared_ptr<EventLoopTimer> > due;
+        for (auto it = mTimers.cbegin(); it != mTimers.cend() && it->first <= mNow; ++it) {
+            for (const auto& t : it->second) {
+                if (auto shared = t.timer.lock())
+                    due.push_back(shared);
+            }
+        }
+        for (const auto& timer : due) {
+            (*timer)();
+            ++fired;
+        }
+    }
+
+    std::vector<std::shared_ptr<EventLoopTimer> > remakes;
+    auto it = mTimers.begin();
+    while (it != mTimers.end() && it->first <= mNow) {
+        auto& vec = it->second;
+        auto t = vec.begin();
+        while (t != vec.end()) {
+            if (t->serial > last) {
+                ++t;
+                continue;
+            }
+            auto shared = t->timer.lock();
+            if (shared && t->type == EventLoopTimer::Interval)
+                remakes.push_back(shared);
+            t = vec.erase(t);
+        }
+        if (vec.empty())
+            it = mTimers.erase(it);
+        else
+            ++it;
+    }
+    for (const auto& timer : remakes)
+        startTimer(timeout(timer.get()), EventLoopTimer::Interval, timer);
+    return fired;
+}
+
+size_t SimulatedHost::advance(uint64_t ns)
+{
+    const uint64_t target = mNow + ns;
+    size_t fired = 0;
+    while (!mTimers.empty() && mTimers.begin()->first <= target) {
+        mNow = std::max(mNow, mTimers.begin()->first);
+        fired += fireDue();
+    }
+    mNow = target;
+    return fired;
+}
+
+size_t SimulatedHost::runUntilIdle(uint64_t limit)
+{
+    const uint64_t target = mNow + limit;
+    size_t fired = 0;
+    while (!mTimers.empty() && mTimers.begin()->first <= target) {
+        mNow = std::max(mNow, mTimers.begin()->first);
+        fired += fireDue();
+    }
+    return fired;
+}
+
+size_t SimulatedHost::pendingTimers() const
+{
+    size_t count = 0;
+    for (const auto& bucket : mTimers) {
+        for (const auto& t : bucket.second) {
+            if (!t.timer.expired())
+                ++count;
+        }
+    }
+    return count;
+}
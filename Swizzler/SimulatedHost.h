@@ -0,0 +1,83 @@
+#ifndef SIMULATEDHOST_H
+#define SIMULATEDHOST_H
+
+#include "Host.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// A Host with a virtual clock and no app behind it. Time only moves when
+// advance() or runUntilIdle() is called, timers fire in due order with the
+// clock set to their due time, and injected events and messages sent to
+// other clients are recorded instead of leaving the process. Runs of the
+// same input are fully repeatable.
+class SimulatedHost : public Host
+{
+public:
+    struct Injected
+    {
+        uint64_t time;
+        std::shared_ptr<EventLoopEvent> event;
+    };
+    struct Sent
+    {
+        uint64_t time;
+        std::string to;
+        int32_t id;
+        std::vector<uint8_t> data;
+    };
+
+    SimulatedHost(uint64_t start = 0);
+
+    void postEvent(const std::shared_ptr<EventLoopEvent>& evt) override;
+    void wakeup() override { ++mWakeups; }
+    uint64_t now() const override { return mNow; }
+    std::shared_ptr<HostPort> connect(const std::string& name) override;
+
+    // moves the clock forward by ns, firing every timer that comes due
+    // on the way. Returns the number of timers fired.
+    size_t advance(uint64_t ns);
+    // keeps advancing to the next timer until none are left or the
+    // clock has moved limit ns
+    size_t runUntilIdle(uint64_t limit);
+
+    size_t pendingTimers() const;
+    uint64_t wakeups() const { return mWakeups; }
+
+    const std::vector<Injected>& injected() const { return mInjected; }
+    void clearInjected() { mInjected.clear(); }
+
+    const std::vector<Sent>& sent() const { return mSent; }
+    void clearSent() { mSent.clear(); }
+
+    // sends to an unreachable client fail as if they'd timed out
+    void setReachable(const std::string& name, bool reachable);
+
+protected:
+    void startTimer(uint32_t when, EventLoopTimer::Type type, const std::shared_ptr<EventLoopTimer>& timer) override;
+    bool stopTimer(const std::shared_ptr<EventLoopTimer>& timer) override;
+
+private:
+    struct Entry
+    {
+        EventLoopTimer::Type type;
+        std::weak_ptr<EventLoopTimer> timer;
+        uint64_t serial; // tells timers started from a callback apart
+    };
+    typedef std::vector<Entry> Timers;
+
+    // fires everything due at or before the current time once, timers
+    // started from a callback wait for the next pass
+    size_t fireDue();
+
+    uint64_t mNow, mWakeups, mSerial;
+    std::map<uint64_t, Timers> mTimers;
+    std::vector<Injected> mInjected;
+    std::vector<Sent> mSent;
+    std::set<std::string> mUnreachable;
+
+    friend class SimulatedPort;
+};
+
+#endif
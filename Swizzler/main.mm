@@ -1,6 +1,12 @@
 #include "MessagePort.h"
+#include "FlatbufferEncoder.h"
 #include "EventLoop.h"
+#include "Replayer.h"
+#include "MessageHandler.h"
+#include "MetricsReport.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <objc/runtime.h>
 #include <string>
 #include <deque>
@@ -10,6 +16,8 @@
 #include <MouseEvent_generated.h>
 #include <Settings_generated.h>
 #include <RemoteAdd_generated.h>
+#include <Protocol.h>
+#include <ScriptStats_generated.h>
 #import <Cocoa/Cocoa.h>
 #import <dispatch/dispatch.h>
 
@@ -36,11 +44,6 @@ static std::string generateUUID()
     return string;
 }
 
-static inline std::string toString(const std::vector<uint8_t>& vec)
-{
-    return std::string(reinterpret_cast<const char*>(&vec[0]), vec.size());
-}
-
 static inline std::vector<uint8_t> toVector(const std::string& str)
 {
     std::vector<uint8_t> vec(str.size());
@@ -78,11 +81,72 @@ static void patchedAddCursorRect(id self, SEL _cmd, NSRect rect, NSCursor* curso
 struct Context
 {
     std::unique_ptr<MessagePortLocal> port;
+    std::unique_ptr<MessagePortRemote> server;
     std::unique_ptr<ScriptEngine> lua;
+    std::unique_ptr<MessageHandler> handler;
+    std::unique_ptr<Replayer> replayer;
+    std::shared_ptr<EventLoopTimer> metricsTimer;
+    std::shared_ptr<EventLoopTimer> registerTimer;
 };
 
 static Context context;
 
+static void handleMessage(int32_t id, const std::vector<uint8_t>& data)
+{
+    (*context.handler)(id, data);
+}
+
+enum { MetricsInterval = 5000, RegisterInterval = 1000 };
+
+static void registerLater()
+{
+    context.registerTimer->stop();
+    context.registerTimer->start(RegisterInterval, EventLoopTimer::Interval);
+}
+
+// tells whoever serves the controller port about us, false if nobody does
+static bool registerWithServer(const std::string& uuid)
+{
+    context.server = std::make_unique<MessagePortRemote>("jhanssen.disseminate.server");
+    context.server->onInvalidated([]() {
+            // the controller went away and whoever serves the port next,
+            // a new daemon or the UI's own controller, doesn't know about
+            // us. We're inside the port's callback, replace it later
+            printf("lost the server\n");
+            registerLater();
+        });
+
+    Disseminate::RemoteAdd::EventT addEvent;
+    {
+        addEvent.uuid = uuid;
+        addEvent.version = Disseminate::Protocol::Version;
+        addEvent.capabilities = Disseminate::Protocol::Capabilities;
+        addEvent.pid = getpid();
+        const char* client = getenv("DISSEMINATE_CLIENT");
+        if (client)
+            addEvent.client = client;
+    }
+
+    FlatbufferEncoder encoder;
+    encoder.finish(Disseminate::RemoteAdd::CreateEvent(encoder.builder(), &addEvent));
+    return context.server->send(Disseminate::FlatbufferTypes::RemoteAdd, encoder.data(), encoder.size());
+}
+
+// the controller matches reports to clients by uuid
+static void reportMetrics(const std::string& uuid)
+{
+    EventLoop* loop = EventLoop::eventLoop();
+    Metrics* metrics = Metrics::instance();
+    metrics->gauge("event_queue_depth").set(loop->pendingEvents());
+    metrics->gauge("timers_pending").set(loop->pendingTimers());
+
+    FlatbufferEncoder encoder;
+    encodeMetrics(encoder, { { uuid, metrics->snapshot() } });
+    // don't hold up the app for a controller that isn't reading
+    if (context.server)
+        context.server->send(Disseminate::FlatbufferTypes::Metrics, encoder.data(), encoder.size(), 0.5);
+}
+
 // static CFDataRef DisseminateCallback(CFMessagePortRef port,
 //                                      SInt32 messageID,
 //                                      CFDataRef data,
@@ -126,82 +190,65 @@ static Context context;
 
                     const std::string uuid = generateUUID();
 
-                    context.lua = std::make_unique<ScriptEngine>(uuid);
+                    context.lua = std::make_unique<ScriptEngine>(uuid, loop);
                     context.lua->registerClient(ScriptEngine::Local, uuid);
 
+                    context.handler = std::make_unique<MessageHandler>(context.lua.get(), loop);
+                    context.handler->onReply([](int32_t id, const uint8_t* data, size_t size) {
+                            // heartbeats go this way, a busy controller
+                            // shouldn't freeze the app
+                            if (context.server)
+                                context.server->send(id, data, size, 1.0);
+                        });
+                    context.handler->onTerminate([]() {
+                            [[NSApplication sharedApplication] terminate:[NSApplication sharedApplication]];
+                        });
+
                     printf("creating local %s\n", uuid.c_str());
                     context.port = std::make_unique<MessagePortLocal>(uuid);
-                    context.port->onMessage([loop](int32_t id, const std::vector<uint8_t>& data) {
-                            switch (id) {
-                            case Disseminate::FlatbufferTypes::Evaluate:
-                                context.lua->evaluate(toString(data));
-                                loop->wakeup();
-                                break;
-                            case Disseminate::FlatbufferTypes::RemoteAdd: {
-                                auto event = Disseminate::RemoteAdd::GetEvent(&data[0])->UnPack();
-                                context.lua->registerClient(ScriptEngine::Remote, event);
-                                loop->wakeup();
-                                break; }
-                            case Disseminate::FlatbufferTypes::RemoteRemove:
-                                context.lua->unregisterClient(ScriptEngine::Remote, toString(data));
-                                loop->wakeup();
-                                break;
-                            case Disseminate::FlatbufferTypes::RemoteClear:
-                                context.lua->clearClients(ScriptEngine::Remote);
-                                loop->wakeup();
-                                break;
-                            case Disseminate::FlatbufferTypes::MouseEvent: {
-                                auto event = Disseminate::Mouse::GetEvent(&data[0])->UnPack();
-                                context.lua->processRemoteMouseEvent(event);
-                                loop->wakeup();
-                                break; }
-                            case Disseminate::FlatbufferTypes::KeyEvent: {
-                                auto event = Disseminate::Key::GetEvent(&data[0])->UnPack();
-                                context.lua->processRemoteKeyEvent(event);
-                                loop->wakeup();
-                                break; }
-                            case Disseminate::FlatbufferTypes::Settings: {
-                                auto event = Disseminate::Settings::GetGlobal(&data[0])->UnPack();
-                                context.lua->processSettings(event);
-                                loop->wakeup();
-                                break; }
-                            case Disseminate::FlatbufferTypes::Terminate:
-                                [[NSApplication sharedApplication] terminate:[NSApplication sharedApplication]];
-                                break;
-                            default:
-                                break;
-                            }
-                        });
+                    context.port->onMessage(handleMessage);
 
                     loop->onEvent([](const std::shared_ptr<EventLoopEvent>& event) -> bool {
                             //printf("iteration\n");
                             return context.lua->processLocalEvent(event);
                         });
+                    loop->onIdle([]() {
+                            context.lua->idle();
+                        });
                     loop->wakeup();
 
-                    const pid_t pid = getpid();
-                    MessagePortRemote remote("jhanssen.disseminate.server");
-
-                    Disseminate::RemoteAdd::EventT addEvent;
-                    {
-                        addEvent.uuid = uuid;
-                        const char* client = getenv("DISSEMINATE_CLIENT");
-                        if (client)
-                            addEvent.client = client;
+                    // keeps trying until there's a controller to take us
+                    context.registerTimer = loop->makeTimer();
+                    context.registerTimer->onTimeout([uuid]() {
+                            if (registerWithServer(uuid))
+                                context.registerTimer->stop();
+                        });
+                    if (!registerWithServer(uuid)) {
+                        printf("couldn't inform server\n");
+                        registerLater();
                     }
 
-                    flatbuffers::FlatBufferBuilder builder;
-                    auto buffer = Disseminate::RemoteAdd::CreateEvent(builder, &addEvent);
-                    builder.Finish(buffer);
-
-                    std::vector<uint8_t> message(builder.GetBufferPointer(),
-                                                 builder.GetBufferPointer() + builder.GetSize());
-
-                    if (!remote.send(pid, message)) {
-                        printf("couldn't inform server\n");
-                        //context.port.reset();
-                        return;
+                    // started after the server port exists so nothing the
+                    // replay triggers finds it missing
+                    if (const char* replay = getenv("DISSEMINATE_REPLAY")) {
+                        // speed multiplier, "max" or 0 plays the log back as fast as possible
+                        double speed = 1;
+                        if (const char* s = getenv("DISSEMINATE_REPLAY_SPEED")) {
+                            char* end = 0;
+                            speed = !strcmp(s, "max") ? 0 : strtod(s, &end);
+                            if (speed < 0 || (end && (end == s || *end)))
+                                speed = 1;
+                        }
+                        context.replayer = std::make_unique<Replayer>(loop, replay, speed);
+                        if (!context.replayer->start(handleMessage))
+                            context.replayer.reset();
                     }
+
+                    context.metricsTimer = loop->makeTimer();
+                    context.metricsTimer->onTimeout([uuid]() {
+                            reportMetrics(uuid);
+                        });
+                    context.metricsTimer->start(MetricsInterval, EventLoopTimer::Interval);
                     // loop->onTerminate([&remote]() {
                     //         remote.send(getpid());
                     //     });
@@ -19,12 +19,14 @@
 #include "TemplateChooser.h"
 #include "Helpers.h"
 #include "Utils.h"
-#include "ProcessInformation.h"
+#include "ThumbnailCapture.h"
 #include "ui_TemplateChooser.h"
 
-TemplateChooser::TemplateChooser(QWidget *parent, const QString& current, const QStringList& temps, int32_t pid, uint64_t windowId) :
+TemplateChooser::TemplateChooser(QWidget *parent, const QString& current, const QStringList& temps, int32_t pid, uint64_t windowId,
+                                 ThumbnailCapture* thumbnails) :
     QDialog(parent),
     ui(new Ui::TemplateChooser),
+    thumbs(thumbnails),
     wpid(pid), wid(windowId)
 {
     ui->setupUi(this);
@@ -42,8 +44,15 @@ TemplateChooser::TemplateChooser(QWidget *parent, const QString& current, const
     connect(this, &TemplateChooser::accepted, this, &TemplateChooser::emitChosen);
 
     screenShot = new helpers::ScreenShotWidget(ui->widget);
-    // this function should probably live in a different file
-    screenShot->setPixmap(getScreenshot(wid));
+    // show the last thumbnail right away, the capture thread keeps it fresh
+    const QImage last = thumbs->thumbnail(wid);
+    if (!last.isNull())
+        screenShot->setPixmap(QPixmap::fromImage(last));
+    connect(thumbs, &ThumbnailCapture::thumbnailReady, this, [this](quint64 windowId, const QImage& image) {
+            if (windowId == wid)
+                screenShot->setPixmap(QPixmap::fromImage(image));
+        });
+    thumbs->watch(wid);
     screenShotLayout = new QVBoxLayout(ui->widget);
     screenShotLayout->addWidget(screenShot);
     screenShot->show();
@@ -51,6 +60,7 @@ TemplateChooser::TemplateChooser(QWidget *parent, const QString& current, const
 
 TemplateChooser::~TemplateChooser()
 {
+    thumbs->unwatch(wid);
     delete ui;
 }
 
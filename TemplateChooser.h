@@ -31,13 +31,15 @@ class ScreenShotWidget;
 }
 
 class QVBoxLayout;
+class ThumbnailCapture;
 
 class TemplateChooser : public QDialog
 {
     Q_OBJECT
 
 public:
-    explicit TemplateChooser(QWidget *parent, const QString& current, const QStringList& temps, int32_t pid, uint64_t windowId);
+    explicit TemplateChooser(QWidget *parent, const QString& current, const QStringList& temps, int32_t pid, uint64_t windowId,
+                             ThumbnailCapture* thumbnails);
     ~TemplateChooser();
 
 signals:
@@ -50,6 +52,7 @@ private:
     Ui::TemplateChooser *ui;
     helpers::ScreenShotWidget* screenShot;
     QVBoxLayout* screenShotLayout;
+    ThumbnailCapture* thumbs;
     int32_t wpid;
     uint64_t wid;
 };
@@ -40,6 +40,9 @@ Templates::Templates(QWidget *parent, const Config& cfg) :
     connect(ui->addKey, &QPushButton::clicked, this, &Templates::addKey);
     connect(ui->removeKey, &QPushButton::clicked, this, &Templates::removeKey);
 
+    connect(ui->addRemap, &QPushButton::clicked, this, &Templates::addRemap);
+    connect(ui->removeRemap, &QPushButton::clicked, this, &Templates::removeRemap);
+
     connect(ui->whitelistRadio, &QRadioButton::toggled, this, &Templates::whiteListChanged);
     connect(ui->blacklistRadio, &QRadioButton::toggled, this, &Templates::blackListChanged);
 
@@ -62,6 +65,7 @@ Templates::~Templates()
 void Templates::templateItemChanged(const QListWidgetItem* templ)
 {
     ui->keyList->clear();
+    ui->remapList->clear();
     if (!templ)
         return;
 
@@ -78,6 +82,10 @@ void Templates::templateItemChanged(const QListWidgetItem* templ)
             ui->keyList->addItem(new KeyItem(name, k.first, k.second));
         }
     }
+
+    for (const auto& r : item.remaps) {
+        ui->remapList->addItem(new RemapItem(r));
+    }
 }
 
 void Templates::addTemplate()
@@ -146,6 +154,55 @@ void Templates::keyAdded(int64_t key, uint64_t mask)
     }
 }
 
+void Templates::addRemap()
+{
+    if (!ui->templateList->currentItem()) {
+        QMessageBox::information(this, "No template selected", "No template selected");
+        return;
+    }
+    QListWidgetItem* titem = ui->templateList->currentItem();
+
+    const KeyCode from = KeyInput::getKeyCode(this);
+    if (helpers::keyIsNull(from))
+        return;
+    const KeyCode to = KeyInput::getKeyCode(this);
+    if (helpers::keyIsNull(to))
+        return;
+
+    // a key can only be remapped to one target, replace any existing remap
+    auto& vec = config[titem->text()].remaps;
+    for (int i = 0; i < vec.size(); ++i) {
+        if (vec[i].first == from) {
+            vec.remove(i);
+            delete ui->remapList->item(i);
+            break;
+        }
+    }
+
+    const KeyRemap remap(from, to);
+    vec.append(remap);
+    ui->remapList->addItem(new RemapItem(remap));
+}
+
+void Templates::removeRemap()
+{
+    if (!ui->templateList->currentItem()) {
+        QMessageBox::information(this, "No template selected", "No template selected");
+        return;
+    }
+    QListWidgetItem* titem = ui->templateList->currentItem();
+    auto& vec = config[titem->text()].remaps;
+
+    const auto& items = ui->remapList->selectedItems();
+    for (auto& item : items) {
+        const RemapItem* ritem = static_cast<const RemapItem*>(item);
+        const int idx = vec.indexOf(ritem->remap);
+        if (idx != -1)
+            vec.remove(idx);
+        delete item;
+    }
+}
+
 void Templates::whiteListChanged()
 {
     if (!ui->templateList->currentItem()) {
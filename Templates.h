@@ -39,6 +39,7 @@ public:
     struct ConfigItem
     {
         QVector<KeyCode> keys;
+        QVector<KeyRemap> remaps;
         bool whitelist;
     };
     typedef QMap<QString, ConfigItem> Config;
@@ -53,6 +54,9 @@ private slots:
     void addKey();
     void removeKey();
 
+    void addRemap();
+    void removeRemap();
+
     void whiteListChanged();
     void blackListChanged();
 
@@ -0,0 +1,95 @@
+/*
+  Disseminate, keyboard broadcaster
+  Copyright (C) 2016  Jan Erik Hanssen
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THUMBNAILCAPTURE_H
+#define THUMBNAILCAPTURE_H
+
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QSet>
+#include <QSize>
+#include <QThread>
+
+class QTimer;
+
+// lives on the capture thread, see ThumbnailCapture
+class ThumbnailWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    ThumbnailWorker();
+
+public slots:
+    void watch(quint64 windowId);
+    void unwatch(quint64 windowId);
+    void setSize(const QSize& size);
+    void setInterval(int ms);
+    void captureAll();
+
+signals:
+    void captured(quint64 windowId, const QImage& image);
+
+private:
+    void capture(quint64 windowId);
+
+    QTimer* timer;
+    QSet<quint64> windows;
+    QSize size;
+};
+
+// Captures downscaled window thumbnails on a background thread. Watched
+// windows are recaptured every interval, each capture is scaled to fit
+// size while still on the capture thread and delivered with
+// thumbnailReady through a queued connection. The last thumbnail of every
+// window is kept so a preview can show something right away.
+class ThumbnailCapture : public QObject
+{
+    Q_OBJECT
+
+public:
+    ThumbnailCapture(QObject* parent = 0);
+    ~ThumbnailCapture();
+
+    void setSize(const QSize& size);
+    // 0 only captures when a window is first watched
+    void setInterval(int ms);
+
+    // watches are counted, a window is captured until every watch is undone
+    void watch(quint64 windowId);
+    void unwatch(quint64 windowId);
+
+    QImage thumbnail(quint64 windowId) const { return thumbnails.value(windowId); }
+    // forgets the thumbnails of windows that aren't in windowIds anymore
+    void prune(const QSet<quint64>& windowIds);
+
+signals:
+    void thumbnailReady(quint64 windowId, const QImage& image);
+
+private slots:
+    void captured(quint64 windowId, const QImage& image);
+
+private:
+    QThread thread;
+    ThumbnailWorker* worker;
+    QHash<quint64, int> watches;
+    QHash<quint64, QImage> thumbnails;
+};
+
+#endif
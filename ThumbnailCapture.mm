@@ -0,0 +1,156 @@
+/*
+    Disseminate, keyboard broadcaster
+    Copyright (C) 2016  Jan Erik Hanssen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThumbnailCapture.h"
+#include <QTimer>
+#import <Cocoa/Cocoa.h>
+
+ThumbnailWorker::ThumbnailWorker()
+    : timer(new QTimer(this)), size(320, 200)
+{
+    timer->setInterval(1000);
+    connect(timer, &QTimer::timeout, this, &ThumbnailWorker::captureAll);
+}
+
+void ThumbnailWorker::watch(quint64 windowId)
+{
+    windows.insert(windowId);
+    capture(windowId);
+    if (timer->interval() > 0 && !timer->isActive())
+        timer->start();
+}
+
+void ThumbnailWorker::unwatch(quint64 windowId)
+{
+    windows.remove(windowId);
+    if (windows.isEmpty())
+        timer->stop();
+}
+
+void ThumbnailWorker::setSize(const QSize& sz)
+{
+    size = sz;
+}
+
+void ThumbnailWorker::setInterval(int ms)
+{
+    timer->setInterval(ms);
+    if (ms > 0 && !windows.isEmpty())
+        timer->start();
+    else
+        timer->stop();
+}
+
+void ThumbnailWorker::captureAll()
+{
+    for (quint64 windowId : windows)
+        capture(windowId);
+}
+
+void ThumbnailWorker::capture(quint64 windowId)
+{
+    // nominal resolution, no point in grabbing retina pixels we'd scale away
+    CGImageRef window = CGWindowListCreateImage(CGRectNull, kCGWindowListOptionIncludingWindow, windowId,
+                                                kCGWindowImageBoundsIgnoreFraming | kCGWindowImageNominalResolution
+                                                | kCGWindowImageShouldBeOpaque);
+    if (!window)
+        return;
+    const QSize full(CGImageGetWidth(window), CGImageGetHeight(window));
+    if (full.isEmpty()) {
+        CGImageRelease(window);
+        return;
+    }
+    const QSize scaled = full.scaled(size, Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+
+    // scale while drawing into the QImage's own buffer, QPixmap isn't
+    // usable off the GUI thread
+    QImage image(scaled, QImage::Format_ARGB32_Premultiplied);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(image.bits(), scaled.width(), scaled.height(), 8,
+                                                 image.bytesPerLine(), colorSpace,
+                                                 kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Host);
+    CGContextSetInterpolationQuality(context, kCGInterpolationMedium);
+    CGContextDrawImage(context, CGRectMake(0, 0, scaled.width(), scaled.height()), window);
+    CGContextRelease(context);
+    CGColorSpaceRelease(colorSpace);
+    CGImageRelease(window);
+
+    emit captured(windowId, image);
+}
+
+ThumbnailCapture::ThumbnailCapture(QObject* parent)
+    : QObject(parent), worker(new ThumbnailWorker)
+{
+    worker->moveToThread(&thread);
+    connect(&thread, &QThread::finished, worker, &QObject::deleteLater);
+    connect(worker, &ThumbnailWorker::captured, this, &ThumbnailCapture::captured, Qt::QueuedConnection);
+    thread.setObjectName("ThumbnailCapture");
+    thread.start(QThread::LowPriority);
+}
+
+ThumbnailCapture::~ThumbnailCapture()
+{
+    thread.quit();
+    thread.wait();
+}
+
+void ThumbnailCapture::setSize(const QSize& size)
+{
+    QMetaObject::invokeMethod(worker, "setSize", Qt::QueuedConnection, Q_ARG(QSize, size));
+}
+
+void ThumbnailCapture::setInterval(int ms)
+{
+    QMetaObject::invokeMethod(worker, "setInterval", Qt::QueuedConnection, Q_ARG(int, ms));
+}
+
+void ThumbnailCapture::watch(quint64 windowId)
+{
+    if (watches[windowId]++ == 0)
+        QMetaObject::invokeMethod(worker, "watch", Qt::QueuedConnection, Q_ARG(quint64, windowId));
+}
+
+void ThumbnailCapture::unwatch(quint64 windowId)
+{
+    auto it = watches.find(windowId);
+    if (it == watches.end())
+        return;
+    if (--it.value() == 0) {
+        watches.erase(it);
+        QMetaObject::invokeMethod(worker, "unwatch", Qt::QueuedConnection, Q_ARG(quint64, windowId));
+    }
+}
+
+void ThumbnailCapture::prune(const QSet<quint64>& windowIds)
+{
+    for (auto it = thumbnails.begin(); it != thumbnails.end();) {
+        if (windowIds.contains(it.key()))
+            ++it;
+        else
+            it = thumbnails.erase(it);
+    }
+}
+
+void ThumbnailCapture::captured(quint64 windowId, const QImage& image)
+{
+    // a late capture for a window nobody looks at anymore
+    if (!watches.contains(windowId))
+        return;
+    thumbnails[windowId] = image;
+    emit thumbnailReady(windowId, image);
+}
@@ -0,0 +1,83 @@
+/*
+  Disseminate, keyboard broadcaster
+  Copyright (C) 2016  Jan Erik Hanssen
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "WindowInventory.h"
+#include <algorithm>
+
+bool WindowInventory::Changes::affects(pid_t pid) const
+{
+    return std::find(added.begin(), added.end(), pid) != added.end()
+        || std::find(changed.begin(), changed.end(), pid) != changed.end()
+        || std::find(removed.begin(), removed.end(), pid) != removed.end();
+}
+
+WindowInventory::WindowInventory(std::unique_ptr<WindowProvider>&& provider)
+    : mProvider(std::move(provider))
+{
+}
+
+WindowInventory::Changes WindowInventory::refresh()
+{
+    Changes changes;
+    std::unordered_map<pid_t, ProcessInformation> next;
+    next.reserve(mWindows.size());
+
+    for (const auto& window : mProvider->windows()) {
+        // front to back, the first window we see for a pid is the one we want
+        if (next.count(window.pid))
+            continue;
+        ProcessInformation info;
+        info.title = window.owner;
+        info.windowId = window.windowId;
+
+        const auto prev = mWindows.find(window.pid);
+        if (prev == mWindows.end()) {
+            info.icon = mProvider->icon(window.pid);
+            changes.added.push_back(window.pid);
+        } else {
+            info.icon = prev->second.icon;
+            if (prev->second.windowId != info.windowId || prev->second.title != info.title)
+                changes.changed.push_back(window.pid);
+        }
+        next.emplace(window.pid, std::move(info));
+    }
+
+    for (const auto& prev : mWindows) {
+        if (!next.count(prev.first))
+            changes.removed.push_back(prev.first);
+    }
+
+    mWindows.swap(next);
+    return changes;
+}
+
+QSet<quint64> WindowInventory::windowIds() const
+{
+    QSet<quint64> ids;
+    ids.reserve(mWindows.size());
+    for (const auto& window : mWindows) {
+        ids.insert(window.second.windowId);
+    }
+    return ids;
+}
+
+const ProcessInformation* WindowInventory::find(pid_t pid) const
+{
+    const auto it = mWindows.find(pid);
+    return it == mWindows.end() ? 0 : &it->second;
+}
@@ -0,0 +1,93 @@
+/*
+  Disseminate, keyboard broadcaster
+  Copyright (C) 2016  Jan Erik Hanssen
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WINDOWINVENTORY_H
+#define WINDOWINVENTORY_H
+
+#include "ProcessInformation.h"
+#include <QHash>
+#include <QSet>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// a shareable, layer 0 window as reported by the window server
+struct WindowRecord
+{
+    pid_t pid;
+    uint64_t windowId;
+    QString owner;
+};
+
+class WindowProvider
+{
+public:
+    virtual ~WindowProvider() { }
+
+    // all windows, front to back
+    virtual std::vector<WindowRecord> windows() = 0;
+    virtual QPixmap icon(pid_t pid) = 0;
+};
+
+// asks CGWindowListCopyWindowInfo, see ProcessInformation.mm
+std::unique_ptr<WindowProvider> createWindowServerProvider();
+
+// hands out whatever it was given, for running the inventory off macOS
+class FakeWindowProvider : public WindowProvider
+{
+public:
+    FakeWindowProvider() : enumerations(0), iconLookups(0) { }
+
+    std::vector<WindowRecord> windows() override { ++enumerations; return records; }
+    QPixmap icon(pid_t pid) override { ++iconLookups; return icons.value(pid); }
+
+    std::vector<WindowRecord> records;
+    QHash<pid_t, QPixmap> icons;
+    unsigned enumerations, iconLookups;
+};
+
+// Keeps the frontmost window of every process, refreshed with a single
+// enumeration of the window list. Icons are looked up once, when a pid
+// first shows up.
+class WindowInventory
+{
+public:
+    WindowInventory(std::unique_ptr<WindowProvider>&& provider);
+
+    struct Changes
+    {
+        std::vector<pid_t> added, changed, removed;
+
+        bool affects(pid_t pid) const;
+    };
+
+    // compared to the previous refresh
+    Changes refresh();
+
+    // as of the last refresh, null if pid has no window
+    const ProcessInformation* find(pid_t pid) const;
+    size_t size() const { return mWindows.size(); }
+    // the windows of every process, as of the last refresh
+    QSet<quint64> windowIds() const;
+
+private:
+    std::unique_ptr<WindowProvider> mProvider;
+    std::unordered_map<pid_t, ProcessInformation> mWindows;
+};
+
+#endif
@@ -0,0 +1,95 @@
+// Compares encoding a key event with a fresh FlatBufferBuilder plus a copy
+// into a std::vector, which is what every send site used to do, with
+// FlatbufferEncoder handing out pooled builders. Allocations are counted
+// by replacing the global operator new.
+
+#include "FlatbufferEncoder.h"
+#include <KeyEvent_generated.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+static uint64_t sAllocations = 0;
+
+void* operator new(size_t size)
+{
+    ++sAllocations;
+    if (void* ptr = malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+static Disseminate::Key::EventT makeEvent()
+{
+    Disseminate::Key::EventT event;
+    event.type = Disseminate::Key::Type_Down;
+    event.keyCode = 12;
+    event.location = std::unique_ptr<Disseminate::Key::Location>(new Disseminate::Key::Location(512, 384));
+    event.modifiers = 0x100;
+    event.timestamp = 1234.5;
+    event.text = "q";
+    event.fromUuid = "BE1C4A50-8D1E-4D8B-9E0C-6A8E3F0B6B21";
+    return event;
+}
+
+// keeps the compiler from dropping the encoded bytes
+static uint64_t sink(const uint8_t* data, size_t size)
+{
+    return size + data[0] + data[size - 1];
+}
+
+template<typename Encode>
+static void run(const char* name, int events, Encode encode)
+{
+    const Disseminate::Key::EventT event = makeEvent();
+    uint64_t checksum = 0;
+    // warm up so the pooled mode is measured in its steady state
+    for (int i = 0; i < 16; ++i)
+        checksum += encode(event);
+
+    const uint64_t allocsBefore = sAllocations;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < events; ++i)
+        checksum += encode(event);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const uint64_t allocs = sAllocations - allocsBefore;
+
+    const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    printf("%-16s %10.1f ns/event %8.2f allocs/event (checksum %llu)\n",
+           name, ns / events, static_cast<double>(allocs) / events,
+           static_cast<unsigned long long>(checksum));
+}
+
+int main(int argc, char** argv)
+{
+    const int events = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    run("builder+vector", events, [](const Disseminate::Key::EventT& event) {
+            flatbuffers::FlatBufferBuilder builder;
+            auto buffer = Disseminate::Key::CreateEvent(builder, &event);
+            builder.Finish(buffer);
+            std::vector<uint8_t> message(builder.GetBufferPointer(),
+                                         builder.GetBufferPointer() + builder.GetSize());
+            return sink(&message[0], message.size());
+        });
+
+    run("pooled encoder", events, [](const Disseminate::Key::EventT& event) {
+            FlatbufferEncoder encoder;
+            encoder.finish(Disseminate::Key::CreateEvent(encoder.builder(), &event));
+            return sink(encoder.data(), encoder.size());
+        });
+
+    return 0;
+}
@@ -0,0 +1,301 @@
+// Fans synthetic key and mouse traffic out to N simulated clients over the
+// real MessagePortLocal/MessagePortRemote transport. Each client is a
+// thread running its own run loop with a local port; each sender is a
+// thread pacing events at a fixed rate, encoding each one once and sending
+// it to every client, the way a Swizzler forwards to its peers. Receivers
+// decode the event and take the latency from the timestamp it carries.
+//
+// disseminate_bench [--clients 1,2,4,...] [--rates 100,1000] [--senders 1]
+//                   [--duration seconds]
+//
+// Prints one JSON document with a run per client count and rate.
+
+#include "MessagePort.h"
+#include "FlatbufferEncoder.h"
+#include <FlatbufferTypes.h>
+#include <KeyEvent_generated.h>
+#include <MouseEvent_generated.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t cpuTime()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const auto ns = [](const timeval& tv) {
+        return static_cast<uint64_t>(tv.tv_sec) * 1000000000ull + tv.tv_usec * 1000ull;
+    };
+    return ns(usage.ru_utime) + ns(usage.ru_stime);
+}
+
+static std::vector<int> parseList(const char* arg)
+{
+    std::vector<int> list;
+    for (const char* p = arg; *p; ) {
+        char* end;
+        const long v = strtol(p, &end, 10);
+        if (end == p)
+            break;
+        if (v > 0)
+            list.push_back(v);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return list;
+}
+
+class Client
+{
+public:
+    Client(const std::string& name)
+        : mName(name), mLoop(0), mReceived(0)
+    {
+        mThread = std::thread([this]() { run(); });
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCond.wait(lock, [this]() { return mLoop != 0; });
+    }
+
+    ~Client()
+    {
+        stop();
+    }
+
+    void stop()
+    {
+        if (mThread.joinable()) {
+            CFRunLoopStop(mLoop);
+            mThread.join();
+        }
+    }
+
+    const std::string& name() const { return mName; }
+    uint64_t received() const { return mReceived.load(std::memory_order_acquire); }
+    // only valid once stop() has returned
+    const std::vector<uint32_t>& latencies() const { return mLatencies; }
+
+private:
+    void run()
+    {
+        MessagePortLocal port(mName);
+        port.onMessage([this](int32_t id, const std::vector<uint8_t>& data) {
+                received(id, data);
+            });
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mLoop = CFRunLoopGetCurrent();
+        }
+        mCond.notify_one();
+        CFRunLoopRun();
+    }
+
+    void received(int32_t id, const std::vector<uint8_t>& data)
+    {
+        if (data.empty())
+            return;
+        flatbuffers::Verifier verifier(&data[0], data.size());
+        double timestamp = 0;
+        switch (id) {
+        case Disseminate::FlatbufferTypes::MouseEvent:
+            if (Disseminate::Mouse::VerifyEventBuffer(verifier))
+                timestamp = Disseminate::Mouse::GetEvent(&data[0])->timestamp();
+            break;
+        case Disseminate::FlatbufferTypes::KeyEvent:
+            if (Disseminate::Key::VerifyEventBuffer(verifier))
+                timestamp = Disseminate::Key::GetEvent(&data[0])->timestamp();
+            break;
+        default:
+            return;
+        }
+        if (timestamp > 0) {
+            const uint64_t latency = now() - static_cast<uint64_t>(timestamp);
+            mLatencies.push_back(std::min<uint64_t>(latency, UINT32_MAX));
+        }
+        mReceived.fetch_add(1, std::memory_order_release);
+    }
+
+    std::string mName;
+    std::thread mThread;
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    CFRunLoopRef mLoop;
+    std::atomic<uint64_t> mReceived;
+    std::vector<uint32_t> mLatencies;
+};
+
+struct Sent
+{
+    uint64_t messages, failed;
+};
+
+// alternates key down/up and mouse moves so both encoders get exercised
+static Sent send(const std::vector<std::unique_ptr<MessagePortRemote> >& remotes,
+                 int rate, uint64_t duration, int offset)
+{
+    Sent sent = { 0, 0 };
+    const uint64_t interval = 1000000000ull / rate;
+    const uint64_t start = now();
+    for (uint64_t i = 0; ; ++i) {
+        const uint64_t due = start + i * interval;
+        if (due - start >= duration)
+            break;
+        const uint64_t current = now();
+        if (due > current)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due - current));
+
+        FlatbufferEncoder encoder;
+        int32_t type;
+        const float x = (i * 7 + offset) % 1920, y = (i * 3 + offset) % 1080;
+        if (i % 4 == 3) {
+            type = Disseminate::FlatbufferTypes::MouseEvent;
+            Disseminate::Mouse::Location location(x, y), delta(1, 1);
+            encoder.finish(Disseminate::Mouse::CreateEvent(encoder.builder(), Disseminate::Mouse::Type_Move,
+                                                           Disseminate::Mouse::Button_None, &location, &delta,
+                                                           0, static_cast<double>(now())));
+        } else {
+            type = Disseminate::FlatbufferTypes::KeyEvent;
+            Disseminate::Key::Location location(x, y);
+            auto text = encoder.builder().CreateString("q");
+            encoder.finish(Disseminate::Key::CreateEvent(encoder.builder(),
+                                                         i % 2 ? Disseminate::Key::Type_Up : Disseminate::Key::Type_Down,
+                                                         12, &location, 0, static_cast<double>(now()),
+                                                         false, text));
+        }
+        for (const auto& remote : remotes) {
+            if (remote->send(type, encoder.data(), encoder.size()))
+                ++sent.messages;
+            else
+                ++sent.failed;
+        }
+    }
+    return sent;
+}
+
+static double percentile(const std::vector<uint32_t>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    const size_t idx = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+    return sorted[idx] / 1000.;
+}
+
+static void run(int clientCount, int rate, int senderCount, double seconds, bool first)
+{
+    std::vector<std::unique_ptr<Client> > clients;
+    for (int i = 0; i < clientCount; ++i) {
+        clients.push_back(std::make_unique<Client>("jhanssen.disseminate.bench." + std::to_string(getpid())
+                                                   + "." + std::to_string(i)));
+    }
+
+    std::vector<std::vector<std::unique_ptr<MessagePortRemote> > > remotes(senderCount);
+    for (auto& r : remotes) {
+        for (const auto& client : clients)
+            r.push_back(std::make_unique<MessagePortRemote>(client->name()));
+    }
+
+    const uint64_t duration = seconds * 1000000000.;
+    const uint64_t cpuStart = cpuTime();
+    const uint64_t start = now();
+
+    std::vector<Sent> sent(senderCount);
+    std::vector<std::thread> senders;
+    for (int i = 0; i < senderCount; ++i) {
+        senders.emplace_back([&, i]() { sent[i] = send(remotes[i], rate, duration, i); });
+    }
+    for (auto& t : senders)
+        t.join();
+
+    uint64_t messages = 0, failed = 0;
+    for (const Sent& s : sent) {
+        messages += s.messages;
+        failed += s.failed;
+    }
+
+    // give the receivers a moment to drain what's still queued
+    uint64_t received = 0;
+    const uint64_t drainDeadline = now() + 2000000000ull;
+    for (;;) {
+        received = 0;
+        for (const auto& client : clients)
+            received += client->received();
+        if (received >= messages || now() > drainDeadline)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const uint64_t elapsed = now() - start;
+    const uint64_t cpu = cpuTime() - cpuStart;
+
+    remotes.clear();
+    std::vector<uint32_t> latencies;
+    latencies.reserve(received);
+    for (const auto& client : clients) {
+        client->stop();
+        latencies.insert(latencies.end(), client->latencies().begin(), client->latencies().end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    const double secs = elapsed / 1000000000.;
+    printf("%s\n    { \"clients\": %d, \"rate\": %d, \"sent\": %llu, \"failed\": %llu, \"received\": %llu, "
+           "\"throughput\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f, \"p999_us\": %.1f, "
+           "\"cpu_ns_per_event\": %.1f }",
+           first ? "" : ",", clientCount, rate,
+           static_cast<unsigned long long>(messages), static_cast<unsigned long long>(failed),
+           static_cast<unsigned long long>(received), secs > 0 ? received / secs : 0.,
+           percentile(latencies, .5), percentile(latencies, .99), percentile(latencies, .999),
+           received ? static_cast<double>(cpu) / received : 0.);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<int> clientCounts = { 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+    std::vector<int> rates = { 100, 1000 };
+    int senders = 1;
+    double seconds = 2;
+
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--clients") && hasValue) {
+            clientCounts = parseList(argv[++i]);
+        } else if (!strcmp(argv[i], "--rates") && hasValue) {
+            rates = parseList(argv[++i]);
+        } else if (!strcmp(argv[i], "--senders") && hasValue) {
+            senders = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--duration") && hasValue) {
+            seconds = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--clients 1,2,4] [--rates 100,1000] [--senders n] [--duration seconds]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    printf("{\n  \"senders\": %d,\n  \"duration\": %.3f,\n  \"runs\": [", senders, seconds);
+    bool first = true;
+    for (int clients : clientCounts) {
+        clients = std::min(clients, 256);
+        for (int rate : rates) {
+            run(clients, rate, senders, seconds, first);
+            first = false;
+        }
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
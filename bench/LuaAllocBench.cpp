@@ -0,0 +1,142 @@
+// Compares the system allocator with LuaAllocator for a lua_State running a
+// handler shaped like the default mouse forwarding script. Events go in the
+// way the engine delivers them, as MouseEvent userdata pushed through
+// EventBindings and collected by lua's GC. Each mode runs in its own process
+// so the reported RSS isn't polluted by the other.
+
+#include "EventBindings.h"
+#include "Events.h"
+#include "LuaAllocator.h"
+#include <MouseEvent_generated.h>
+#include <lua.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+static const char* sScript =
+    "local sent = 0\n"
+    "local function send(ev) sent = sent + ev:x() + ev:y() end\n"
+    "function acceptMouse(type, me)\n"
+    "  if me:x() < 0 then\n"
+    "    return false\n"
+    "  end\n"
+    "  local out = me:clone()\n"
+    "  out:set_x(me:x() + 1)\n"
+    "  send(out)\n"
+    "  return true\n"
+    "end\n";
+
+static uint64_t residentBytes()
+{
+#ifdef __APPLE__
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return info.resident_size;
+#else
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f)
+        return 0;
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+        resident = 0;
+    fclose(f);
+    return static_cast<uint64_t>(resident) * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+struct SystemAllocator
+{
+    SystemAllocator() : allocations(0), systemAllocations(0) { }
+
+    static void* alloc(void* ud, void* ptr, size_t osize, size_t nsize)
+    {
+        SystemAllocator* allocator = static_cast<SystemAllocator*>(ud);
+        if (!nsize) {
+            free(ptr);
+            return 0;
+        }
+        if (!ptr || nsize > osize)
+            ++allocator->allocations;
+        ++allocator->systemAllocations;
+        return realloc(ptr, nsize);
+    }
+
+    uint64_t allocations;
+    uint64_t systemAllocations;
+};
+
+// allocations is what lua asked for, systemAllocations what reached malloc
+static void run(const char* name, lua_State* l, const uint64_t& allocations, const uint64_t& systemAllocations, int events)
+{
+    luaL_openlibs(l);
+    EventBindings::registerTypes(l);
+    if (luaL_dostring(l, sScript)) {
+        printf("script error: %s\n", lua_tostring(l, -1));
+        return;
+    }
+
+    const uint64_t rssBefore = residentBytes();
+    const uint64_t allocsBefore = allocations;
+    const uint64_t systemBefore = systemAllocations;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < events; ++i) {
+        lua_getglobal(l, "acceptMouse");
+        lua_pushinteger(l, 0);
+        EventBindings::push(l, MouseEvent(Disseminate::Mouse::Type_Move, Disseminate::Mouse::Button_None, i % 1920, i % 1080));
+        if (lua_pcall(l, 2, 1, 0)) {
+            printf("handler error: %s\n", lua_tostring(l, -1));
+            return;
+        }
+        lua_pop(l, 1);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const uint64_t allocs = allocations - allocsBefore;
+    const uint64_t system = systemAllocations - systemBefore;
+
+    printf("%-8s %d events in %.3fs, %.0f events/s, %.1f allocations/event, %.3f system allocations/event, rss %.1fMB -> %.1fMB\n",
+           name, events, elapsed.count(), events / elapsed.count(),
+           static_cast<double>(allocs) / events, static_cast<double>(system) / events,
+           rssBefore / (1024. * 1024.), residentBytes() / (1024. * 1024.));
+}
+
+static void runSystem(int events)
+{
+    SystemAllocator allocator;
+    lua_State* l = lua_newstate(SystemAllocator::alloc, &allocator);
+    run("system", l, allocator.allocations, allocator.systemAllocations, events);
+    lua_close(l);
+}
+
+static void runPool(int events)
+{
+    LuaAllocator allocator;
+    lua_State* l = lua_newstate(LuaAllocator::alloc, &allocator);
+    const LuaAllocator::Stats& stats = allocator.stats();
+    run("pool", l, stats.totalAllocations, stats.systemAllocations, events);
+    lua_close(l);
+}
+
+int main(int argc, char** argv)
+{
+    const int events = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    void (*modes[])(int) = { runSystem, runPool };
+    for (auto mode : modes) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            mode(events);
+            fflush(stdout);
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+    }
+    return 0;
+}
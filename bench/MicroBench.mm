@@ -0,0 +1,284 @@
+// Microbenchmarks for the pieces every forwarded event goes through, so a
+// change to one of them can be measured on its own. Each case reports
+// ns/op and allocs/op, allocations being counted by replacing the global
+// operator new (lua's own allocations go through LuaAllocator and aren't
+// included, see lua_alloc_bench for those).
+//
+// disseminate_microbench [iterations] [filter]
+
+#include "FlatbufferEncoder.h"
+#include "EventLoop.h"
+#include <FlatbufferTypes.h>
+#include <KeyEvent_generated.h>
+#include <MouseEvent_generated.h>
+#include <Settings_generated.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#import <Cocoa/Cocoa.h>
+// Sucky Cocoa
+#undef check
+#include "ScriptEngine.h"
+
+static uint64_t sAllocations = 0;
+
+void* operator new(size_t size)
+{
+    ++sAllocations;
+    if (void* ptr = malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+static int sIterations = 1000000;
+static const char* sFilter = 0;
+static uint64_t sSink = 0;
+
+// ops is how many operations one call to func performs
+template<typename Func>
+static void bench(const std::string& name, int iterations, Func func, int ops = 1)
+{
+    if (sFilter && !strstr(name.c_str(), sFilter))
+        return;
+    for (int i = 0; i < std::min(iterations, 100); ++i)
+        func(i);
+
+    const uint64_t allocsBefore = sAllocations;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        func(i);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const uint64_t allocs = sAllocations - allocsBefore;
+
+    const double total = static_cast<double>(iterations) * ops;
+    const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    printf("%-28s %12.1f ns/op %8.2f allocs/op\n", name.c_str(), ns / total, allocs / total);
+    fflush(stdout);
+}
+
+static const char* sUuid = "BE1C4A50-8D1E-4D8B-9E0C-6A8E3F0B6B21";
+
+static Disseminate::Mouse::EventT makeMouse()
+{
+    Disseminate::Mouse::EventT event;
+    event.type = Disseminate::Mouse::Type_Move;
+    event.button = Disseminate::Mouse::Button_None;
+    event.location = std::make_unique<Disseminate::Mouse::Location>(512, 384);
+    event.delta = std::make_unique<Disseminate::Mouse::Location>(2, -1);
+    event.timestamp = 1234.5;
+    event.fromUuid = sUuid;
+    return event;
+}
+
+static Disseminate::Key::EventT makeKey()
+{
+    Disseminate::Key::EventT event;
+    event.type = Disseminate::Key::Type_Down;
+    event.keyCode = 12;
+    event.location = std::make_unique<Disseminate::Key::Location>(512, 384);
+    event.modifiers = 0x100;
+    event.timestamp = 1234.5;
+    event.text = "q";
+    event.fromUuid = sUuid;
+    return event;
+}
+
+static void benchPacking()
+{
+    const Disseminate::Mouse::EventT mouse = makeMouse();
+    bench("mouse pack", sIterations, [&](int) {
+            FlatbufferEncoder encoder;
+            encoder.finish(Disseminate::Mouse::CreateEvent(encoder.builder(), &mouse));
+            sSink += encoder.size();
+        });
+
+    const Disseminate::Key::EventT key = makeKey();
+    bench("key pack", sIterations, [&](int) {
+            FlatbufferEncoder encoder;
+            encoder.finish(Disseminate::Key::CreateEvent(encoder.builder(), &key));
+            sSink += encoder.size();
+        });
+
+    // unpacking the way the message handler does, verify then UnPack
+    FlatbufferEncoder mouseEncoder;
+    mouseEncoder.finish(Disseminate::Mouse::CreateEvent(mouseEncoder.builder(), &mouse));
+    const std::vector<uint8_t> mouseData(mouseEncoder.data(), mouseEncoder.data() + mouseEncoder.size());
+    bench("mouse unpack", sIterations, [&](int) {
+            flatbuffers::Verifier verifier(&mouseData[0], mouseData.size());
+            if (!Disseminate::Mouse::VerifyEventBuffer(verifier))
+                abort();
+            auto event = Disseminate::Mouse::GetEvent(&mouseData[0])->UnPack();
+            sSink += event->type;
+        });
+
+    FlatbufferEncoder keyEncoder;
+    keyEncoder.finish(Disseminate::Key::CreateEvent(keyEncoder.builder(), &key));
+    const std::vector<uint8_t> keyData(keyEncoder.data(), keyEncoder.data() + keyEncoder.size());
+    bench("key unpack", sIterations, [&](int) {
+            flatbuffers::Verifier verifier(&keyData[0], keyData.size());
+            if (!Disseminate::Key::VerifyEventBuffer(verifier))
+                abort();
+            auto event = Disseminate::Key::GetEvent(&keyData[0])->UnPack();
+            sSink += event->keyCode;
+        });
+}
+
+static NSEvent* makeMouseEvent(NSEventType type)
+{
+    return [NSEvent mouseEventWithType:type location:NSMakePoint(512, 384) modifierFlags:0
+                             timestamp:1234.5 windowNumber:0 context:nil eventNumber:0
+                            clickCount:1 pressure:1];
+}
+
+static NSEvent* makeKeyEvent(NSEventType type)
+{
+    return [NSEvent keyEventWithType:type location:NSMakePoint(512, 384) modifierFlags:0
+                           timestamp:1234.5 windowNumber:0 context:nil characters:@"q"
+                 charactersIgnoringModifiers:@"q" isARepeat:NO keyCode:12];
+}
+
+static void benchConstruction()
+{
+    @autoreleasepool {
+        NSEvent* mouse = makeMouseEvent(NSMouseMoved);
+        bench("MouseEvent(NSEvent*)", sIterations, [&](int) {
+                const MouseEvent event(mouse);
+                sSink += event.isValid();
+            });
+        bench("MouseEvent(type, button, x, y)", sIterations, [&](int i) {
+                const MouseEvent event(Disseminate::Mouse::Type_Move, Disseminate::Mouse::Button_None, i % 1920, i % 1080);
+                sSink += event.isValid();
+            });
+
+        NSEvent* key = makeKeyEvent(NSKeyDown);
+        bench("KeyEvent(NSEvent*)", sIterations, [&](int) {
+                @autoreleasepool {
+                    const KeyEvent event(key);
+                    sSink += event.isValid();
+                }
+            });
+        bench("KeyEvent(type, code, x, y)", sIterations, [&](int i) {
+                const KeyEvent event(Disseminate::Key::Type_Down, i % 128, 512, 384);
+                sSink += event.isValid();
+            });
+    }
+}
+
+static void benchDispatch()
+{
+    @autoreleasepool {
+        ScriptEngine engine(sUuid, EventLoop::eventLoop());
+        engine.registerClient(ScriptEngine::Local, sUuid);
+        // a peer without a port on the other end, so sendToAll encodes
+        // for it and the send itself fails right away
+        engine.registerClient(ScriptEngine::Remote, "00000000-0000-0000-0000-00000000BE0C");
+
+        Disseminate::Settings::GlobalT global;
+        global.type = Disseminate::Settings::Type_WhiteList;
+        for (int code = 0; code < 64; ++code)
+            global.keys.push_back({ code, 0 });
+        global.toggleKeyboard = std::make_unique<Disseminate::Settings::Key>(122, 0);
+        global.toggleMouse = std::make_unique<Disseminate::Settings::Key>(120, 0);
+        FlatbufferEncoder encoder;
+        encoder.finish(Disseminate::Settings::CreateGlobal(encoder.builder(), &global));
+        engine.processSettings(Disseminate::Settings::GetGlobal(encoder.data()));
+
+        // acceptKeys: whitelisted, so it's forwarded with sendToAll. The
+        // NSEvent is converted each time like the event loop does
+        NSEvent* down = makeKeyEvent(NSKeyDown);
+        NSEvent* up = makeKeyEvent(NSKeyUp);
+        bench("lua acceptKeys", sIterations, [&](int i) {
+                @autoreleasepool {
+                    sSink += engine.processLocalEvent(std::make_shared<EventLoopEvent>(KeyEvent(i % 2 ? up : down)));
+                }
+            });
+
+        // acceptMouse: not capturing, the common case for local mouse moves
+        NSEvent* move = makeMouseEvent(NSMouseMoved);
+        bench("lua acceptMouse", sIterations, [&](int) {
+                @autoreleasepool {
+                    sSink += engine.processLocalEvent(std::make_shared<EventLoopEvent>(MouseEvent(move)));
+                }
+            });
+        engine.idle();
+    }
+}
+
+static void benchTimers()
+{
+    EventLoop* loop = EventLoop::eventLoop();
+    for (int count : { 10, 100, 1000 }) {
+        // zero interval timers are due on every pass, so each pass fires
+        // and reschedules all of them
+        std::vector<std::shared_ptr<EventLoopTimer> > timers;
+        for (int i = 0; i < count; ++i) {
+            timers.push_back(loop->makeTimer());
+            timers.back()->onTimeout([]() { ++sSink; });
+            timers.back()->start(0, EventLoopTimer::Interval);
+        }
+        bench("fireTimers x" + std::to_string(count) + " (per timer)", std::max(sIterations / count, 10),
+              [&](int) { loop->processTimers(); }, count);
+        for (const auto& timer : timers)
+            timer->stop();
+    }
+}
+
+static void benchSettings()
+{
+    for (int keyCount : { 64, 1024, 16384 }) {
+        // mirrors MainWindow::pushSettings, the global list plus a few
+        // templates with keys and remaps of their own
+        bench("pushSettings " + std::to_string(keyCount) + " keys", std::max(sIterations / keyCount, 10), [&](int) {
+                Disseminate::Settings::GlobalT global;
+                global.type = Disseminate::Settings::Type_WhiteList;
+                for (int i = 0; i < keyCount; ++i)
+                    global.keys.push_back({ i, static_cast<uint64_t>(i % 4) << 17 });
+                global.toggleKeyboard = std::make_unique<Disseminate::Settings::Key>(122, 0);
+                global.toggleMouse = std::make_unique<Disseminate::Settings::Key>(120, 0);
+                for (int c = 0; c < 4; ++c) {
+                    std::unique_ptr<Disseminate::Settings::ClientT> client(new Disseminate::Settings::ClientT);
+                    client->uuid = sUuid;
+                    client->type = Disseminate::Settings::Type_BlackList;
+                    for (int i = 0; i < keyCount / 4; ++i)
+                        client->keys.push_back({ i, 0 });
+                    for (int i = 0; i < 16; ++i)
+                        client->remaps.push_back({ { i, 0 }, { i + 18, 0 } });
+                    global.specifics.push_back(std::move(client));
+                }
+                FlatbufferEncoder encoder;
+                encoder.finish(Disseminate::Settings::CreateGlobal(encoder.builder(), &global));
+                sSink += encoder.size();
+            });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1)
+        sIterations = std::max(1, atoi(argv[1]));
+    if (argc > 2)
+        sFilter = argv[2];
+
+    benchPacking();
+    benchConstruction();
+    benchDispatch();
+    benchTimers();
+    benchSettings();
+
+    printf("(checksum %llu)\n", static_cast<unsigned long long>(sSink));
+    return 0;
+}
@@ -0,0 +1,75 @@
+// Compares looking up each client's window with its own pass over the
+// window list, which is what reloadClients used to do, with a single
+// WindowInventory refresh. Runs against FakeWindowProvider so it works off
+// macOS, the window list copy is modelled by the provider returning a
+// fresh vector on every enumeration.
+//
+// window_inventory_bench [windows] [iterations]
+
+#include "WindowInventory.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+static uint64_t sSink = 0;
+
+static void fill(FakeWindowProvider& provider, int windows, int pids)
+{
+    provider.records.clear();
+    for (int i = 0; i < windows; ++i) {
+        WindowRecord record;
+        record.pid = 1000 + i % pids;
+        record.windowId = i + 1;
+        record.owner = QStringLiteral("Process %1").arg(record.pid);
+        provider.records.push_back(record);
+    }
+}
+
+template<typename Func>
+static double measure(int iterations, Func func)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        func();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char** argv)
+{
+    const int windows = argc > 1 ? atoi(argv[1]) : 500;
+    const int iterations = argc > 2 ? atoi(argv[2]) : 200;
+
+    printf("%8s %8s %14s %14s\n", "windows", "clients", "per-pid us", "inventory us");
+    for (int clients : { 1, 8, 32, 128, 256 }) {
+        FakeWindowProvider scan;
+        fill(scan, windows, std::max(clients, windows / 4));
+        const double perPid = measure(iterations, [&]() {
+                for (int c = 0; c < clients; ++c) {
+                    const pid_t pid = 1000 + c;
+                    for (const auto& window : scan.windows()) {
+                        if (window.pid == pid) {
+                            sSink += window.windowId;
+                            break;
+                        }
+                    }
+                }
+            });
+
+        auto provider = std::make_unique<FakeWindowProvider>();
+        fill(*provider, windows, std::max(clients, windows / 4));
+        WindowInventory inventory(std::move(provider));
+        const double single = measure(iterations, [&]() {
+                const WindowInventory::Changes changes = inventory.refresh();
+                sSink += changes.added.size();
+                for (int c = 0; c < clients; ++c) {
+                    if (const ProcessInformation* info = inventory.find(1000 + c))
+                        sSink += info->windowId;
+                }
+            });
+
+        printf("%8d %8d %14.1f %14.1f\n", windows, clients, perPid, single);
+    }
+    printf("(checksum %llu)\n", static_cast<unsigned long long>(sSink));
+    return 0;
+}
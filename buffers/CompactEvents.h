@@ -0,0 +1,58 @@
+#ifndef COMPACT_EVENTS_H
+#define COMPACT_EVENTS_H
+
+#include <stdint.h>
+
+// Fixed size records for the common mouse and key events, sent as
+// FlatbufferTypes::CompactMouseEvent and CompactKeyEvent. The sender is
+// identified by the small id handed out by the controller (see
+// Identity.fbs) instead of a uuid string. Both ends run on the same
+// machine so the records go over the wire in native layout. Events that
+// don't fit a record are sent as the regular Mouse/Key tables.
+
+namespace Disseminate {
+namespace Compact {
+
+enum Flags {
+    HasLocation = 0x1,
+    HasDelta = 0x2,
+    Repeat = 0x4
+};
+
+struct MouseRecord
+{
+    double timestamp;
+    float x, y;
+    float deltaX, deltaY;
+    float pressure;
+    uint32_t modifiers;
+    uint16_t sender;
+    uint8_t type;   // Mouse::Type
+    uint8_t button; // Mouse::Button
+    uint8_t clickCount;
+    uint8_t flags;
+    uint8_t reserved[2];
+};
+
+enum { MaxText = 13 };
+
+struct KeyRecord
+{
+    double timestamp;
+    float x, y;
+    uint32_t modifiers;
+    uint16_t keyCode;
+    uint16_t sender;
+    uint8_t type; // Key::Type
+    uint8_t flags;
+    uint8_t textLength;
+    char text[MaxText]; // utf-8, not terminated
+};
+
+static_assert(sizeof(MouseRecord) == 40, "MouseRecord layout changed");
+static_assert(sizeof(KeyRecord) == 40, "KeyRecord layout changed");
+
+} // namespace Compact
+} // namespace Disseminate
+
+#endif
@@ -11,7 +11,19 @@ enum {
     RemoteClear = 5,
     KeyEvent = 6,
     Settings = 7,
-    Terminate = 8
+    Terminate = 8,
+    ScriptStatsRequest = 9,
+    ScriptStats = 10,
+    CompactMouseEvent = 11,
+    CompactKeyEvent = 12,
+    Identity = 13,
+    // controller to UI only, see Controller/ControlServer.h
+    Roster = 14,
+    // clients to controller, and the combined report on to the UI
+    Metrics = 15,
+    // controller to client, echoed back with the client's uuid
+    Heartbeat = 16,
+    PeerState = 17
 };
 }
 }
@@ -0,0 +1,26 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+
+// Exchanged in RemoteAdd when a client registers and passed on to its
+// peers, so each pair of peers can use the fastest encoding they both
+// understand. Clients from before the handshake report version 0 and no
+// capabilities, which means the plain flatbuffer tables.
+
+namespace Disseminate {
+namespace Protocol {
+
+enum { Version = 1 };
+
+enum Capability : uint64_t {
+    CompactEvents = 0x1 // understands CompactMouseEvent and CompactKeyEvent
+};
+
+// everything this build supports
+static const uint64_t Capabilities = CompactEvents;
+
+} // namespace Protocol
+} // namespace Disseminate
+
+#endif
@@ -0,0 +1,165 @@
+#include "EventLog.h"
+#include <chrono>
+#include <memory>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace EventLog {
+
+static const char sMagic[8] = { 'D', 'S', 'M', 'N', 'L', 'O', 'G', 0 };
+enum { Version = 1, SegmentSize = 16 * 1024 * 1024 };
+
+uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Writer::Writer(const std::string& path)
+    : mFd(-1), mMap(0), mMapped(0), mUsed(0)
+{
+    mFd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (mFd == -1) {
+        printf("unable to open event log %s\n", path.c_str());
+        return;
+    }
+    if (!grow(sizeof(FileHeader))) {
+        close(mFd);
+        mFd = -1;
+        return;
+    }
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, sMagic, sizeof(sMagic));
+    header.version = Version;
+    memcpy(mMap, &header, sizeof(header));
+    mUsed = sizeof(header);
+}
+
+Writer::~Writer()
+{
+    if (mMap)
+        munmap(mMap, mMapped);
+    if (mFd != -1) {
+        // drop the unused tail of the last segment
+        if (ftruncate(mFd, mUsed) == -1)
+            printf("unable to truncate event log\n");
+        close(mFd);
+    }
+}
+
+bool Writer::grow(size_t needed)
+{
+    size_t size = mMapped;
+    while (size < mUsed + needed)
+        size += SegmentSize;
+    if (ftruncate(mFd, size) == -1)
+        return false;
+    if (mMap)
+        munmap(mMap, mMapped);
+    void* map = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (map == MAP_FAILED) {
+        printf("unable to map event log\n");
+        mMap = 0;
+        mMapped = 0;
+        return false;
+    }
+    mMap = static_cast<uint8_t*>(map);
+    mMapped = size;
+    return true;
+}
+
+void Writer::append(Source source, int32_t type, const uint8_t* data, size_t size)
+{
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.size = size;
+    header.type = type;
+    header.timestamp = now();
+    header.source = source;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mMap)
+        return;
+    if (mUsed + sizeof(header) + size > mMapped && !grow(sizeof(header) + size))
+        return;
+    memcpy(mMap + mUsed, &header, sizeof(header));
+    if (size)
+        memcpy(mMap + mUsed + sizeof(header), data, size);
+    mUsed += sizeof(header) + size;
+}
+
+Writer* recorder()
+{
+    static std::unique_ptr<Writer> writer = []() -> std::unique_ptr<Writer> {
+        const char* env = getenv("DISSEMINATE_RECORD");
+        if (!env || !*env)
+            return std::unique_ptr<Writer>();
+        std::string path = env;
+        const size_t pid = path.find("%p");
+        if (pid != std::string::npos)
+            path.replace(pid, 2, std::to_string(getpid()));
+        std::unique_ptr<Writer> w(new Writer(path));
+        if (!w->isOpen())
+            w.reset();
+        return w;
+    }();
+    return writer.get();
+}
+
+Reader::Reader(const std::string& path)
+    : mFd(-1), mMap(0), mSize(0), mOffset(sizeof(FileHeader))
+{
+    mFd = open(path.c_str(), O_RDONLY);
+    if (mFd == -1) {
+        printf("unable to open event log %s\n", path.c_str());
+        return;
+    }
+    struct stat st;
+    if (fstat(mFd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(FileHeader))
+        return;
+    void* map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, mFd, 0);
+    if (map == MAP_FAILED)
+        return;
+    const FileHeader* header = static_cast<const FileHeader*>(map);
+    if (memcmp(header->magic, sMagic, sizeof(sMagic)) || header->version != Version) {
+        printf("%s is not an event log\n", path.c_str());
+        munmap(map, st.st_size);
+        return;
+    }
+    mMap = static_cast<const uint8_t*>(map);
+    mSize = st.st_size;
+}
+
+Reader::~Reader()
+{
+    if (mMap)
+        munmap(const_cast<uint8_t*>(mMap), mSize);
+    if (mFd != -1)
+        close(mFd);
+}
+
+bool Reader::next(Record& record)
+{
+    if (!mMap || mOffset + sizeof(RecordHeader) > mSize)
+        return false;
+    RecordHeader header;
+    memcpy(&header, mMap + mOffset, sizeof(header));
+    // a log that wasn't closed cleanly ends in the zeroed tail of its last segment
+    if (!header.timestamp || mOffset + sizeof(header) + header.size > mSize)
+        return false;
+    record.source = static_cast<Source>(header.source);
+    record.type = header.type;
+    record.timestamp = header.timestamp;
+    record.data = mMap + mOffset + sizeof(header);
+    record.size = header.size;
+    mOffset += sizeof(header) + header.size;
+    return true;
+}
+
+} // namespace EventLog
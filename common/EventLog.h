@@ -0,0 +1,96 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <mutex>
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+// Append-only recording of event traffic. Records go to an mmap'd file
+// that grows a segment at a time, so recording an event is a memcpy. Each
+// record is a RecordHeader followed by the payload: the message exactly as
+// it went over the wire for received messages, and the Mouse/Key table the
+// event would be sent as for captured input.
+//
+// Recording is enabled by pointing DISSEMINATE_RECORD at a file, a %p in
+// the path is replaced by the pid so several processes can record at once.
+namespace EventLog {
+
+enum Source : uint8_t { Captured, Received };
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct RecordHeader
+{
+    uint32_t size; // payload bytes following the header
+    int32_t type;  // FlatbufferTypes id, or the registering pid for RemoteAdd
+    uint64_t timestamp; // monotonic nanoseconds
+    uint8_t source;
+    uint8_t reserved[7];
+};
+
+// monotonic nanoseconds, the clock the timestamps are taken from
+uint64_t now();
+
+class Writer
+{
+public:
+    Writer(const std::string& path);
+    ~Writer();
+
+    bool isOpen() const { return mMap != 0; }
+    void append(Source source, int32_t type, const uint8_t* data, size_t size);
+
+private:
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    bool grow(size_t needed);
+
+    std::mutex mMutex;
+    int mFd;
+    uint8_t* mMap;
+    size_t mMapped, mUsed;
+};
+
+// the process wide recorder, null unless DISSEMINATE_RECORD is set
+Writer* recorder();
+
+class Reader
+{
+public:
+    struct Record
+    {
+        Source source;
+        int32_t type;
+        uint64_t timestamp;
+        const uint8_t* data;
+        size_t size;
+    };
+
+    Reader(const std::string& path);
+    ~Reader();
+
+    bool isOpen() const { return mMap != 0; }
+
+    // false at the end of the log, or at a record that was cut short
+    bool next(Record& record);
+    void rewind() { mOffset = sizeof(FileHeader); }
+
+private:
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    int mFd;
+    const uint8_t* mMap;
+    size_t mSize, mOffset;
+};
+
+} // namespace EventLog
+
+#endif
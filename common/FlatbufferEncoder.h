@@ -0,0 +1,76 @@
+#ifndef FLATBUFFERENCODER_H
+#define FLATBUFFERENCODER_H
+
+#include "ThreadLocalStore.h"
+#include <flatbuffers/flatbuffers.h>
+#include <vector>
+
+// Borrows a cleared FlatBufferBuilder from a per thread pool for the
+// lifetime of the encoder, so a message reuses the buffer that earlier
+// messages on the same thread already grew. The finished buffer can be
+// passed to MessagePortRemote::send as is, without copying it to a vector.
+class FlatbufferEncoder
+{
+public:
+    FlatbufferEncoder()
+    {
+        auto& builders = pool()->builders;
+        if (builders.empty()) {
+            mBuilder = new flatbuffers::FlatBufferBuilder(InitialSize);
+        } else {
+            mBuilder = builders.back();
+            builders.pop_back();
+        }
+    }
+    ~FlatbufferEncoder()
+    {
+        auto& builders = pool()->builders;
+        if (builders.size() < MaxPooled) {
+            mBuilder->Clear();
+            mBuilder->ForceDefaults(false);
+            builders.push_back(mBuilder);
+        } else {
+            delete mBuilder;
+        }
+    }
+
+    flatbuffers::FlatBufferBuilder& builder() { return *mBuilder; }
+
+    template<typename T>
+    void finish(flatbuffers::Offset<T> root) { mBuilder->Finish(root); }
+
+    const uint8_t* data() const { return mBuilder->GetBufferPointer(); }
+    size_t size() const { return mBuilder->GetSize(); }
+
+private:
+    FlatbufferEncoder(const FlatbufferEncoder&) = delete;
+    FlatbufferEncoder& operator=(const FlatbufferEncoder&) = delete;
+
+    enum { InitialSize = 256, MaxPooled = 4 };
+
+    struct Pool
+    {
+        Pool() { }
+        ~Pool()
+        {
+            for (auto builder : builders)
+                delete builder;
+        }
+
+        std::vector<flatbuffers::FlatBufferBuilder*> builders;
+
+    private:
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+    };
+
+    static Pool* pool()
+    {
+        static ThreadLocalStore<Pool> store;
+        return store.get();
+    }
+
+    flatbuffers::FlatBufferBuilder* mBuilder;
+};
+
+#endif
@@ -14,6 +14,10 @@ public:
     MessagePortLocal(const std::string& name);
     ~MessagePortLocal();
 
+    // false if the port couldn't be created, usually because someone
+    // else already serves that name
+    bool isValid() const { return mSource != 0; }
+
     typedef std::function<void(int32_t id, const std::vector<uint8_t>& data)> MessageCallback;
     void onMessage(const MessageCallback& on) { mMessageCallback = on; }
 
@@ -40,6 +44,9 @@ public:
 
     bool send(int32_t id) const ;
     bool send(int32_t id, const std::vector<uint8_t>& data) const;
+    // data only has to stay valid for the duration of the call,
+    // timeout is in seconds
+    bool send(int32_t id, const uint8_t* data, size_t size, double timeout = 10.0) const;
     bool send(int32_t id, const std::string& data) const;
     bool send(const std::vector<uint8_t>& data) const;
 
@@ -1,5 +1,6 @@
 #include "MessagePort.h"
 #include "CocoaUtils.h"
+#include "EventLog.h"
 #import <Cocoa/Cocoa.h>
 #include <objc/runtime.h>
 
@@ -71,6 +72,8 @@ CFDataRef MessagePortLocal::messageCallback(CFMessagePortRef port, SInt32 messag
                 memcpy(&str[0], CFDataGetBytePtr(data), len);
             }
         }
+        if (EventLog::Writer* log = EventLog::recorder())
+            log->append(EventLog::Received, messageID, str.empty() ? 0 : &str[0], str.size());
         local->mMessageCallback(messageID, str);
     }
     return 0;
@@ -117,12 +120,13 @@ void MessagePortRemote::invalidatedCallback(CFMessagePortRef port, void *info)
     }
 }
 
-bool MessagePortRemote::send(int32_t id, const std::vector<uint8_t>& data) const
+bool MessagePortRemote::send(int32_t id, const uint8_t* data, size_t size, double timeout) const
 {
     if (!mPort)
         return false;
-    const CFTimeInterval timeout = 10.0;
-    CFDataRef dataref = data.empty() ? nullptr : CFDataCreate(NULL, &data[0], data.size());
+    // the request is copied into the mach message before
+    // CFMessagePortSendRequest returns, no need to copy it here
+    CFDataRef dataref = size ? CFDataCreateWithBytesNoCopy(NULL, data, size, kCFAllocatorNull) : nullptr;
     SInt32 status = CFMessagePortSendRequest(mPort,
                                              id,
                                              dataref,
@@ -130,15 +134,19 @@ bool MessagePortRemote::send(int32_t id, const std::vector<uint8_t>& data) const
                                              timeout,
                                              NULL,
                                              NULL);
+    if (dataref)
+        CFRelease(dataref);
     return (status == kCFMessagePortSuccess);
 }
 
+bool MessagePortRemote::send(int32_t id, const std::vector<uint8_t>& data) const
+{
+    return send(id, data.empty() ? nullptr : &data[0], data.size());
+}
+
 bool MessagePortRemote::send(int32_t id, const std::string& data) const
 {
-    std::vector<uint8_t> udata;
-    udata.resize(data.size());
-    memcpy(&udata[0], &data[0], data.size());
-    return send(id, udata);
+    return send(id, reinterpret_cast<const uint8_t*>(data.data()), data.size());
 }
 
 bool MessagePortRemote::send(int32_t id) const
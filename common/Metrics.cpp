@@ -0,0 +1,87 @@
+#include "Metrics.h"
+
+Metrics* Metrics::instance()
+{
+    static Metrics metrics;
+    return &metrics;
+}
+
+Metrics::Value& Metrics::value(const std::string& name, Kind kind)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::unique_ptr<Entry>& entry = mEntries[name];
+    if (!entry) {
+        entry.reset(new Entry);
+        entry->kind = kind;
+    }
+    return entry->value;
+}
+
+std::vector<Metrics::Sample> Metrics::snapshot() const
+{
+    std::vector<Sample> samples;
+    std::lock_guard<std::mutex> lock(mMutex);
+    samples.reserve(mEntries.size());
+    for (const auto& entry : mEntries) {
+        samples.push_back({ entry.first, entry.second->kind, entry.second->value.get() });
+    }
+    return samples;
+}
+
+static std::string escapeLabel(const std::string& value)
+{
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"')
+            out += '\\';
+        if (c == '\n')
+            out += "\\n";
+        else
+            out += c;
+    }
+    return out;
+}
+
+std::string Metrics::labeled(const std::string& metric, const std::string& label, const std::string& value)
+{
+    return metric + "{" + label + "=\"" + escapeLabel(value) + "\"}";
+}
+
+std::string Metrics::formatText(const std::vector<Source>& sources)
+{
+    // all samples of a metric have to follow its TYPE line
+    struct Family
+    {
+        Kind kind;
+        std::string lines;
+    };
+    std::map<std::string, Family> families;
+    for (const Source& source : sources) {
+        const std::string label = "source=\"" + escapeLabel(source.name) + "\"";
+        for (const Sample& sample : source.samples) {
+            // metric name is everything up to the labels, if any
+            const size_t brace = sample.name.find('{');
+            const std::string metric = "disseminate_" + sample.name.substr(0, brace);
+            auto family = families.find(metric);
+            if (family == families.end())
+                family = families.insert(std::make_pair(metric, Family { sample.kind, std::string() })).first;
+            std::string& lines = family->second.lines;
+            lines += metric;
+            if (brace == std::string::npos)
+                lines += "{" + label + "}";
+            else
+                lines += "{" + label + "," + sample.name.substr(brace + 1);
+            lines += ' ';
+            lines += std::to_string(sample.value);
+            lines += '\n';
+        }
+    }
+
+    std::string out;
+    for (const auto& family : families) {
+        out += "# TYPE " + family.first + (family.second.kind == Counter ? " counter\n" : " gauge\n");
+        out += family.second.lines;
+    }
+    return out;
+}
@@ -0,0 +1,85 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Process wide counters and gauges. A value is registered by name the
+// first time it's asked for and stays at the same address for the life of
+// the process, so hot paths look it up once and keep the reference:
+//
+//   static Metrics::Value& sent = Metrics::instance()->counter("events_forwarded");
+//   sent.add();
+//
+// Names may carry Prometheus style labels, e.g. send_failures{peer="..."};
+// build those with labeled() so the value gets escaped.
+class Metrics
+{
+public:
+    enum Kind { Counter, Gauge };
+
+    class Value
+    {
+    public:
+        Value() : mValue(0) { }
+
+        void add(uint64_t n = 1) { mValue.fetch_add(n, std::memory_order_relaxed); }
+        void set(uint64_t v) { mValue.store(v, std::memory_order_relaxed); }
+        uint64_t get() const { return mValue.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> mValue;
+    };
+
+    struct Sample
+    {
+        std::string name;
+        Kind kind;
+        uint64_t value;
+    };
+
+    static Metrics* instance();
+
+    Value& counter(const std::string& name) { return value(name, Counter); }
+    Value& gauge(const std::string& name) { return value(name, Gauge); }
+
+    // metric{label="value"}, with value escaped for the text format
+    static std::string labeled(const std::string& metric, const std::string& label, const std::string& value);
+
+    // sorted by name
+    std::vector<Sample> snapshot() const;
+
+    // the samples of one process
+    struct Source
+    {
+        std::string name;
+        std::vector<Sample> samples;
+    };
+
+    // Prometheus text exposition. Every sample is labeled with the name of
+    // its source, so the controller and its clients can share one file
+    static std::string formatText(const std::vector<Source>& sources);
+
+private:
+    Metrics() { }
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    Value& value(const std::string& name, Kind kind);
+
+    struct Entry
+    {
+        Kind kind;
+        Value value;
+    };
+
+    mutable std::mutex mMutex;
+    std::map<std::string, std::unique_ptr<Entry> > mEntries;
+};
+
+#endif
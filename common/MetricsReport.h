@@ -0,0 +1,60 @@
+#ifndef METRICSREPORT_H
+#define METRICSREPORT_H
+
+#include "Metrics.h"
+#include "FlatbufferEncoder.h"
+#include <Metrics_generated.h>
+
+// Metrics sources to and from a Metrics.Report
+
+inline void encodeMetrics(FlatbufferEncoder& encoder, const std::vector<Metrics::Source>& sources)
+{
+    auto& builder = encoder.builder();
+    std::vector<flatbuffers::Offset<Disseminate::Metrics::Source> > out;
+    out.reserve(sources.size());
+    std::vector<flatbuffers::Offset<Disseminate::Metrics::Sample> > samples;
+    for (const Metrics::Source& source : sources) {
+        samples.clear();
+        samples.reserve(source.samples.size());
+        for (const Metrics::Sample& sample : source.samples) {
+            samples.push_back(Disseminate::Metrics::CreateSample(builder, builder.CreateString(sample.name),
+                                                                 sample.kind == Metrics::Counter
+                                                                 ? Disseminate::Metrics::Kind_Counter
+                                                                 : Disseminate::Metrics::Kind_Gauge,
+                                                                 sample.value));
+        }
+        const auto name = builder.CreateString(source.name);
+        out.push_back(Disseminate::Metrics::CreateSource(builder, name, builder.CreateVector(samples)));
+    }
+    encoder.finish(Disseminate::Metrics::CreateReport(builder, builder.CreateVector(out)));
+}
+
+// false if data isn't a valid report
+inline bool decodeMetrics(const uint8_t* data, size_t size, std::vector<Metrics::Source>& sources)
+{
+    if (!data || !size)
+        return false;
+    flatbuffers::Verifier verifier(data, size);
+    if (!Disseminate::Metrics::VerifyReportBuffer(verifier))
+        return false;
+    const auto report = Disseminate::Metrics::GetReport(data);
+    if (!report->sources())
+        return true;
+    for (const Disseminate::Metrics::Source* source : *report->sources()) {
+        Metrics::Source out;
+        if (source->name())
+            out.name = source->name()->str();
+        if (const auto samples = source->samples()) {
+            out.samples.reserve(samples->size());
+            for (const Disseminate::Metrics::Sample* sample : *samples) {
+                out.samples.push_back({ sample->name() ? sample->name()->str() : std::string(),
+                                        sample->kind() == Disseminate::Metrics::Kind_Counter ? Metrics::Counter : Metrics::Gauge,
+                                        sample->value() });
+            }
+        }
+        sources.push_back(std::move(out));
+    }
+    return true;
+}
+
+#endif
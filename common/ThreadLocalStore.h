@@ -0,0 +1,82 @@
+#ifndef THREADLOCALSTORE_H
+#define THREADLOCALSTORE_H
+
+#include <pthread.h>
+
+// silly Apple making me do this, I hear Xcode 8 will have thread_local, just ~6 years late
+template<typename T>
+class ThreadLocalStore
+{
+public:
+    ThreadLocalStore()
+    {
+        pthread_once(&tlsOnce, init);
+    }
+
+    void set(const T& t)
+    {
+        if (void* ptr = pthread_getspecific(tls)) {
+            *static_cast<T*>(ptr) = t;
+        } else {
+            pthread_setspecific(tls, new T(t));
+        }
+    }
+
+    void remove()
+    {
+        if (void* ptr =pthread_getspecific(tls)) {
+            delete static_cast<T*>(ptr);
+            pthread_setspecific(tls, 0);
+        }
+    }
+
+    T* get()
+    {
+        if (void* ptr = pthread_getspecific(tls)) {
+            return static_cast<T*>(ptr);
+        } else {
+            T* t = new T;
+            pthread_setspecific(tls, t);
+            return t;
+        }
+    }
+    const T* get() const
+    {
+        if (const void* ptr = pthread_getspecific(tls)) {
+            return static_cast<const T*>(ptr);
+        } else {
+            T* t = new T;
+            pthread_setspecific(tls, t);
+            return t;
+        }
+    }
+    T* operator->()
+    {
+        return get();
+    }
+    const T* operator->() const
+    {
+        return get();
+    }
+
+private:
+    static void init()
+    {
+        pthread_key_create(&tls, destroy);
+    }
+    static void destroy(void* obj)
+    {
+        delete static_cast<T*>(obj);
+    }
+
+private:
+    static pthread_once_t tlsOnce;
+    static pthread_key_t tls;
+};
+
+template<typename T>
+pthread_once_t ThreadLocalStore<T>::tlsOnce = PTHREAD_ONCE_INIT;
+template<typename T>
+pthread_key_t ThreadLocalStore<T>::tls;
+
+#endif
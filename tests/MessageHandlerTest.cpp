@@ -0,0 +1,108 @@
+#include "MessageHandler.h"
+#include "ScriptEngine.h"
+#include "SimulatedHost.h"
+#include "FlatbufferEncoder.h"
+#include "Metrics.h"
+#include <FlatbufferTypes.h>
+#include <KeyEvent_generated.h>
+#include <RemoteAdd_generated.h>
+#include <Protocol.h>
+#include <gtest/gtest.h>
+
+static const char* sUuid = "BE1C4A50-8D1E-4D8B-9E0C-6A8E3F0B6B21";
+static const char* sPeer = "00000000-0000-0000-0000-00000000BE0C";
+
+class MessageHandlerTest : public ::testing::Test
+{
+protected:
+    MessageHandlerTest()
+        : engine(sUuid, &host), handler(&engine, &host), terminated(0)
+    {
+        handler.onReply([this](int32_t id, const uint8_t* data, size_t size) {
+                replies.push_back(std::make_pair(id, std::string(reinterpret_cast<const char*>(data), size)));
+            });
+        handler.onTerminate([this]() { ++terminated; });
+    }
+
+    void deliver(int32_t id, const FlatbufferEncoder& encoder)
+    {
+        handler(id, std::vector<uint8_t>(encoder.data(), encoder.data() + encoder.size()));
+    }
+    void deliver(int32_t id, const std::string& data)
+    {
+        handler(id, std::vector<uint8_t>(data.begin(), data.end()));
+    }
+    void addPeer(const std::string& uuid)
+    {
+        Disseminate::RemoteAdd::EventT add;
+        add.uuid = uuid;
+        add.version = Disseminate::Protocol::Version;
+        FlatbufferEncoder encoder;
+        encoder.finish(Disseminate::RemoteAdd::CreateEvent(encoder.builder(), &add));
+        deliver(Disseminate::FlatbufferTypes::RemoteAdd, encoder);
+    }
+
+    SimulatedHost host;
+    ScriptEngine engine;
+    MessageHandler handler;
+    std::vector<std::pair<int32_t, std::string> > replies;
+    int terminated;
+};
+
+TEST_F(MessageHandlerTest, RemoteKeysAreInjected)
+{
+    Disseminate::Key::EventT key;
+    key.type = Disseminate::Key::Type_Down;
+    key.keyCode = 12;
+    key.fromUuid = sPeer;
+    FlatbufferEncoder encoder;
+    encoder.finish(Disseminate::Key::CreateEvent(encoder.builder(), &key));
+    deliver(Disseminate::FlatbufferTypes::KeyEvent, encoder);
+
+    // the default script injects whatever arrives from remote clients
+    ASSERT_EQ(host.injected().size(), 1u);
+    EXPECT_EQ(host.injected()[0].event->kevt.keyCode(), 12);
+    EXPECT_GE(host.wakeups(), 1u);
+}
+
+TEST_F(MessageHandlerTest, RemoteAddAndRemove)
+{
+    const std::string send = "keyEvent.sendToAll(KeyEvent.new(enums.KeyDown, 3, 0, 0))";
+    addPeer(sPeer);
+    deliver(Disseminate::FlatbufferTypes::Evaluate, send);
+    ASSERT_EQ(host.sent().size(), 1u);
+    EXPECT_EQ(host.sent()[0].to, sPeer);
+
+    host.clearSent();
+    deliver(Disseminate::FlatbufferTypes::RemoteRemove, sPeer);
+    deliver(Disseminate::FlatbufferTypes::Evaluate, send);
+    EXPECT_TRUE(host.sent().empty());
+
+    addPeer(sPeer);
+    deliver(Disseminate::FlatbufferTypes::RemoteClear, std::string());
+    deliver(Disseminate::FlatbufferTypes::Evaluate, send);
+    EXPECT_TRUE(host.sent().empty());
+}
+
+TEST_F(MessageHandlerTest, HeartbeatsAreAnsweredWithOurUuid)
+{
+    deliver(Disseminate::FlatbufferTypes::Heartbeat, std::string());
+    ASSERT_EQ(replies.size(), 1u);
+    EXPECT_EQ(replies[0].first, Disseminate::FlatbufferTypes::Heartbeat);
+    EXPECT_EQ(replies[0].second, sUuid);
+}
+
+TEST_F(MessageHandlerTest, Terminate)
+{
+    deliver(Disseminate::FlatbufferTypes::Terminate, std::string());
+    EXPECT_EQ(terminated, 1);
+}
+
+TEST_F(MessageHandlerTest, TruncatedRecordsAreDropped)
+{
+    Metrics::Value& dropped = Metrics::instance()->counter("events_dropped");
+    const uint64_t before = dropped.get();
+    deliver(Disseminate::FlatbufferTypes::CompactKeyEvent, std::string(3, '\0'));
+    EXPECT_EQ(dropped.get(), before + 1);
+    EXPECT_TRUE(host.injected().empty());
+}
@@ -0,0 +1,18 @@
+#include "Metrics.h"
+#include <gtest/gtest.h>
+
+TEST(Metrics, LabeledEscapesTheValue)
+{
+    EXPECT_EQ(Metrics::labeled("send_failures", "peer", "plain"), "send_failures{peer=\"plain\"}");
+    EXPECT_EQ(Metrics::labeled("send_failures", "peer", "a\"b\\c\nd"), "send_failures{peer=\"a\\\"b\\\\c\\nd\"}");
+}
+
+TEST(Metrics, FormatTextKeepsLabelsIntact)
+{
+    const std::string name = Metrics::labeled("send_failures", "peer", "evil\"} 1\n{");
+    const std::vector<Metrics::Sample> samples = { { name, Metrics::Counter, 3 } };
+    const std::string text = Metrics::formatText({ { "controller", samples } });
+    EXPECT_EQ(text,
+              "# TYPE disseminate_send_failures counter\n"
+              "disseminate_send_failures{source=\"controller\",peer=\"evil\\\"} 1\\n{\"} 3\n");
+}
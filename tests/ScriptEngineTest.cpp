@@ -0,0 +1,235 @@
+#include "ScriptEngine.h"
+#include "SimulatedHost.h"
+#include "Events.h"
+#include <FlatbufferTypes.h>
+#include <gtest/gtest.h>
+
+static const uint64_t Millisecond = 1000000;
+static const char* sUuid = "BE1C4A50-8D1E-4D8B-9E0C-6A8E3F0B6B21";
+static const char* sPeer = "00000000-0000-0000-0000-00000000BE0C";
+
+TEST(ScriptEngine, InjectsThroughTheHost)
+{
+    SimulatedHost host;
+    ScriptEngine engine(sUuid, &host);
+    engine.evaluate("keyEvent.inject(KeyEvent.new(enums.KeyDown, 12, 10, 20))");
+
+    ASSERT_EQ(host.injected().size(), 1u);
+    const auto& event = host.injected()[0].event;
+    EXPECT_TRUE(event->kevt.isValid());
+    EXPECT_FALSE(event->mevt.isValid());
+    EXPECT_EQ(event->kevt.keyCode(), 12);
+}
+
+TEST(ScriptEngine, TimersRunOnTheHostClock)
+{
+    SimulatedHost host;
+    ScriptEngine engine(sUuid, &host);
+    engine.evaluate("timers.startTimeout(function() keyEvent.inject(KeyEvent.new(enums.KeyUp, 1, 0, 0)) end, 50)");
+
+    host.advance(49 * Millisecond);
+    EXPECT_TRUE(host.injected().empty());
+    host.advance(1 * Millisecond);
+    ASSERT_EQ(host.injected().size(), 1u);
+    EXPECT_EQ(host.injected()[0].time, 50 * Millisecond);
+}
+
+TEST(ScriptEngine, SequencesPostAtTheirOffsets)
+{
+    SimulatedHost host;
+    ScriptEngine engine(sUuid, &host);
+    engine.evaluate("sequence.start({ { delay = 10, event = KeyEvent.new(enums.KeyDown, 1, 0, 0) },\n"
+                    "                 { delay = 20, event = KeyEvent.new(enums.KeyUp, 1, 0, 0) } })");
+
+    host.runUntilIdle(1000 * Millisecond);
+    ASSERT_EQ(host.injected().size(), 2u);
+    EXPECT_EQ(host.injected()[0].time, 10 * Millisecond);
+    EXPECT_EQ(host.injected()[1].time, 30 * Millisecond);
+    EXPECT_EQ(host.pendingTimers(), 0u);
+}
+
+TEST(ScriptEngine, SequencesStartedFromATimerComplete)
+{
+    SimulatedHost host;
+    ScriptEngine engine(sUuid, &host);
+    // all steps are due right away, completion goes through a 0 timer
+    engine.evaluate("timers.startTimeout(function()\n"
+                    "  sequence.start({ { delay = 0, event = KeyEvent.new(enums.KeyDown, 1, 0, 0) } },\n"
+                    "                 function() keyEvent.inject(KeyEvent.new(enums.KeyUp, 2, 0, 0)) end)\n"
+                    "end, 10)");
+
+    host.runUntilIdle(1000 * Millisecond);
+    ASSERT_EQ(host.injected().size(), 2u);
+    EXPECT_EQ(host.injected()[1].event->kevt.keyCode(), 2);
+    EXPECT_EQ(host.pendingTimers(), 0u);
+}
+
+TEST(ScriptEngine, InvalidSequencesStartNothing)
+{
+    SimulatedHost host;
+    ScriptEngine engine(sUuid, &host);
+    // the second step is only found to be bad after the first was read
+    engine.evaluate("local ok = pcall(sequence.start, { { delay = 10, event = KeyEvent.new(enums.KeyDown, 1, 0, 0) },\n"
+                    "                                   { delay = 5 } })\n"
+                    "if not ok then keyEvent.inject(KeyEvent.new(enums.KeyUp, 9, 0, 0)) end");
+
+    host.runUntilIdle(1000 * Millisecond);
+    ASSERT_EQ(host.injected().size(), 1u);
+    EXPECT_EQ(host.injected()[0].event->kevt.keyCode(), 9);
+}
+
+TEST(ScriptEngine, LocalEventsCanBeBlocked)
+{
+    SimulatedHost host;
+    ScriptEngine engine(sUuid, &host);
+    engine.evaluate("keyEvent.on(function(type, ke) return ke:keycode() ~= 7 end)");
+
+    EXPECT_FALSE(engine.processLocalEvent(std::make_shared<EventLoopEvent>(KeyEvent(Disseminate::Key::Type_Down, 7, 0, 0))));
+    EXPECT_TRUE(engine.processLocalEvent(std::make_shared<EventLoopEvent>(KeyEvent(Disseminate::Key::Type_Down, 8, 0, 0))));
+}
+
+TEST(ScriptEngine, HandlersCanAwait)
+{
+    SimulatedHost host;
+    ScriptEngine engine(sUuid, &host);
+    engine.evaluate("keyEvent.on(function(type, ke)\n"
+                    "  if ke:keycode() ~= 1 then return false end\n"
+                    "  await(sleep(20))\n"
+                    "  keyEvent.inject(KeyEvent.new(enums.KeyUp, 2, 0, 0))\n"
+                    "end)");
+
+    // the handler that awaits accepted its event, the other one still blocks
+    EXPECT_TRUE(engine.processLocalEvent(std::make_shared<EventLoopEvent>(KeyEvent(Disseminate::Key::Type_Down, 1, 0, 0))));
+    EXPECT_FALSE(engine.processLocalEvent(std::make_shared<EventLoopEvent>(KeyEvent(Disseminate::Key::Type_Down, 3, 0, 0))));
+    EXPECT_TRUE(host.injected().empty());
+
+    host.advance(20 * Millisecond);
+    ASSERT_EQ(host.injected().size(), 1u);
+    EXPECT_EQ(host.injected()[0].event->kevt.keyCode(), 2);
+}
+
+TEST(ScriptEngine, ResumedCoroutinesHaveABudget)
+{
+    SimulatedHost host;
+    ScriptEngine engine(sUuid, &host);
+    engine.evaluate("profiler.setBudget(100000)\n"
+                    "keyEvent.on(function(type, ke)\n"
+                    "  await(sleep(1))\n"
+                    "  keyEvent.inject(KeyEvent.new(enums.KeyUp, 5, 0, 0))\n"
+                    "  while true do end\n"
+                    "end)");
+
+    EXPECT_TRUE(engine.processLocalEvent(std::make_shared<EventLoopEvent>(KeyEvent(Disseminate::Key::Type_Down, 1, 0, 0))));
+    // would never return if the loop ran unchecked
+    host.advance(1 * Millisecond);
+    ASSERT_EQ(host.injected().size(), 1u);
+    engine.evaluate("for _, s in ipairs(profiler.stats()) do\n"
+                    "  if s.kind == 'coroutines' and s.aborted == 1 then keyEvent.inject(KeyEvent.new(enums.KeyUp, 6, 0, 0)) end\n"
+                    "end");
+    ASSERT_EQ(host.injected().size(), 2u);
+    EXPECT_EQ(host.injected()[1].event->kevt.keyCode(), 6);
+}
+
+TEST(ScriptEngine, SendToAllReachesRemoteClients)
+{
+    SimulatedHost host;
+    ScriptEngine engine(sUuid, &host);
+    engine.registerClient(ScriptEngine::Local, sUuid);
+    engine.registerClient(ScriptEngine::Remote, sPeer);
+    engine.evaluate("mouseEvent.sendToAll(MouseEvent.new(enums.MouseMove, enums.MouseButtonNone, 1, 2))");
+
+    ASSERT_EQ(host.sent().size(), 1u);
+    EXPECT_EQ(host.sent()[0].to, sPeer);
+    EXPECT_EQ(host.sent()[0].id, Disseminate::FlatbufferTypes::MouseEvent);
+    const auto event = Disseminate::Mouse::GetEvent(&host.sent()[0].data[0]);
+    EXPECT_EQ(event->location()->x(), 1);
+    EXPECT_EQ(event->location()->y(), 2);
+    EXPECT_EQ(event->fromUuid()->str(), sUuid);
+
+    engine.unregisterClient(ScriptEngine::Remote, sPeer);
+    host.clearSent();
+    engine.evaluate("mouseEvent.sendToAll(MouseEvent.new(enums.MouseMove, enums.MouseButtonNone, 1, 2))");
+    EXPECT_TRUE(host.sent().empty());
+}
+
+TEST(ScriptEngine, DegradedStateGoesWithTheClient)
+{
+    SimulatedHost host;
+    ScriptEngine engine(sUuid, &host);
+    const std::string send = "mouseEvent.sendToAll(MouseEvent.new(enums.MouseMove, enums.MouseButtonNone, 1, 2))";
+    engine.registerClient(ScriptEngine::Remote, sPeer);
+    engine.setPeerState(sPeer, true);
+    engine.evaluate(send);
+    EXPECT_TRUE(host.sent().empty());
+
+    // a settings push clears and re-adds everyone
+    engine.clearClients(ScriptEngine::Remote);
+    engine.registerClient(ScriptEngine::Remote, sPeer);
+    engine.evaluate(send);
+    ASSERT_EQ(host.sent().size(), 1u);
+
+    engine.setPeerState(sPeer, true);
+    engine.unregisterClient(ScriptEngine::Remote, sPeer);
+    engine.registerClient(ScriptEngine::Remote, sPeer);
+    host.clearSent();
+    engine.evaluate(send);
+    EXPECT_EQ(host.sent().size(), 1u);
+}
+
+TEST(ScriptEngine, FailedSendsStallThePeer)
+{
+    SimulatedHost host;
+    ScriptEngine engine(sUuid, &host);
+    const std::string send = "mouseEvent.sendToAll(MouseEvent.new(enums.MouseMove, enums.MouseButtonNone, 1, 2))";
+    engine.registerClient(ScriptEngine::Remote, sPeer);
+    host.setReachable(sPeer, false);
+    engine.evaluate(send);
+    EXPECT_TRUE(host.sent().empty());
+
+    // scripts see the failure
+    engine.evaluate("if not keyEvent.sendTo(KeyEvent.new(enums.KeyDown, 1, 0, 0), '" + std::string(sPeer) + "') then\n"
+                    "  keyEvent.inject(KeyEvent.new(enums.KeyUp, 3, 0, 0))\n"
+                    "end");
+    EXPECT_EQ(host.injected().size(), 1u);
+
+    // left out without waiting on the controller, then tried again
+    host.setReachable(sPeer, true);
+    engine.evaluate(send);
+    EXPECT_TRUE(host.sent().empty());
+    host.advance(1000 * Millisecond);
+    engine.evaluate(send);
+    EXPECT_EQ(host.sent().size(), 1u);
+}
+
+TEST(ScriptEngine, HandlesSurviveClearsAndAreReused)
+{
+    SimulatedHost host;
+    ScriptEngine engine(sUuid, &host);
+    engine.evaluate("handles = {}\n"
+                    "clients.on(function(change, type, uuid, handle) handles[uuid] = handle end)\n"
+                    "function sendTo(handle) return keyEvent.sendTo(KeyEvent.new(enums.KeyDown, 1, 0, 0), handle) end");
+    engine.registerClient(ScriptEngine::Remote, "a");
+    engine.registerClient(ScriptEngine::Remote, "b");
+    engine.evaluate("ha, hb = handles.a, handles.b");
+
+    // what a settings push does, everyone keeps their handle
+    engine.clearClients(ScriptEngine::Remote);
+    engine.registerClient(ScriptEngine::Remote, "b");
+    engine.registerClient(ScriptEngine::Remote, "a");
+    engine.evaluate("sendTo(ha) sendTo(hb)");
+    ASSERT_EQ(host.sent().size(), 2u);
+    EXPECT_EQ(host.sent()[0].to, "a");
+    EXPECT_EQ(host.sent()[1].to, "b");
+
+    // unknown uuids don't take a slot, so c gets the one a left behind,
+    // but a's old handle doesn't lead to it
+    engine.unregisterClient(ScriptEngine::Remote, "a");
+    engine.unregisterClient(ScriptEngine::Remote, "unknown");
+    engine.setPeerState("unknown", true);
+    engine.registerClient(ScriptEngine::Remote, "c");
+    host.clearSent();
+    engine.evaluate("if sendTo(ha) == false and sendTo(handles.c) then sendTo(hb) end");
+    ASSERT_EQ(host.sent().size(), 2u);
+    EXPECT_EQ(host.sent()[0].to, "c");
+    EXPECT_EQ(host.sent()[1].to, "b");
+}
@@ -0,0 +1,88 @@
+#include "SimulatedHost.h"
+#include <gtest/gtest.h>
+
+static const uint64_t Millisecond = 1000000;
+
+TEST(SimulatedHost, TimersFireInDueOrder)
+{
+    SimulatedHost host;
+    std::vector<int> order;
+    auto late = host.makeTimer();
+    late->onTimeout([&]() { order.push_back(2); });
+    late->start(20);
+    auto early = host.makeTimer();
+    early->onTimeout([&]() { order.push_back(1); });
+    early->start(10);
+
+    EXPECT_EQ(host.advance(9 * Millisecond), 0u);
+    EXPECT_EQ(host.advance(11 * Millisecond), 2u);
+    EXPECT_EQ(order, std::vector<int>({ 1, 2 }));
+    EXPECT_EQ(host.now(), 20 * Millisecond);
+    EXPECT_EQ(host.pendingTimers(), 0u);
+}
+
+TEST(SimulatedHost, IntervalsKeepFiringUntilStopped)
+{
+    SimulatedHost host;
+    int fired = 0;
+    auto timer = host.makeTimer();
+    timer->onTimeout([&]() { ++fired; });
+    timer->start(10, EventLoopTimer::Interval);
+
+    host.advance(100 * Millisecond);
+    EXPECT_EQ(fired, 10);
+    EXPECT_TRUE(timer->stop());
+    host.advance(100 * Millisecond);
+    EXPECT_EQ(fired, 10);
+}
+
+TEST(SimulatedHost, RestartFromTheCallbackFiresAgain)
+{
+    SimulatedHost host;
+    int fired = 0;
+    auto timer = host.makeTimer();
+    timer->onTimeout([&]() {
+            if (++fired < 3)
+                timer->restart(0);
+        });
+    timer->start(10);
+
+    host.advance(10 * Millisecond);
+    EXPECT_EQ(fired, 1);
+    host.advance(2 * Millisecond);
+    EXPECT_EQ(fired, 3);
+    EXPECT_EQ(host.pendingTimers(), 0u);
+}
+
+TEST(SimulatedHost, ZeroTimersStartedFromACallbackFireNextPass)
+{
+    SimulatedHost host;
+    int fired = 0;
+    auto later = host.makeTimer();
+    later->onTimeout([&]() { ++fired; });
+    auto timer = host.makeTimer();
+    timer->onTimeout([&]() { later->start(0); });
+    timer->start(10);
+
+    EXPECT_EQ(host.advance(10 * Millisecond), 2u);
+    EXPECT_EQ(fired, 1);
+    EXPECT_EQ(host.pendingTimers(), 0u);
+}
+
+TEST(SimulatedHost, RecordsSendsAndInjectedEvents)
+{
+    SimulatedHost host(5 * Millisecond);
+    auto port = host.connect("peer");
+    const std::vector<uint8_t> data = { 1, 2, 3 };
+    EXPECT_TRUE(port->send(42, data));
+    ASSERT_EQ(host.sent().size(), 1u);
+    EXPECT_EQ(host.sent()[0].time, 5 * Millisecond);
+    EXPECT_EQ(host.sent()[0].to, "peer");
+    EXPECT_EQ(host.sent()[0].id, 42);
+    EXPECT_EQ(host.sent()[0].data, data);
+
+    host.postEvent(std::make_shared<EventLoopEvent>(KeyEvent(Disseminate::Key::Type_Down, 12, 0, 0)));
+    ASSERT_EQ(host.injected().size(), 1u);
+    EXPECT_TRUE(host.injected()[0].event->kevt.isValid());
+    EXPECT_EQ(host.wakeups(), 1u);
+}
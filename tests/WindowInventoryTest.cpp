@@ -0,0 +1,98 @@
+#include "WindowInventory.h"
+#include <QGuiApplication>
+#include <algorithm>
+#include <gtest/gtest.h>
+
+static WindowRecord window(pid_t pid, uint64_t windowId, const char* owner)
+{
+    WindowRecord record;
+    record.pid = pid;
+    record.windowId = windowId;
+    record.owner = QString::fromUtf8(owner);
+    return record;
+}
+
+class WindowInventoryTest : public ::testing::Test
+{
+protected:
+    WindowInventoryTest()
+        : provider(new FakeWindowProvider), inventory(std::unique_ptr<WindowProvider>(provider))
+    {
+    }
+
+    FakeWindowProvider* provider;
+    WindowInventory inventory;
+};
+
+TEST_F(WindowInventoryTest, NewProcessesAreAdded)
+{
+    provider->records = { window(10, 1, "Terminal"), window(20, 2, "Finder"), window(10, 3, "Terminal") };
+    const auto changes = inventory.refresh();
+
+    EXPECT_EQ(changes.added, std::vector<pid_t>({ 10, 20 }));
+    EXPECT_TRUE(changes.changed.empty());
+    EXPECT_TRUE(changes.removed.empty());
+    EXPECT_EQ(inventory.size(), 2u);
+    // the frontmost window wins
+    ASSERT_TRUE(inventory.find(10));
+    EXPECT_EQ(inventory.find(10)->windowId, 1u);
+    EXPECT_EQ(provider->iconLookups, 2u);
+}
+
+TEST_F(WindowInventoryTest, GoneProcessesAreRemoved)
+{
+    provider->records = { window(10, 1, "Terminal"), window(20, 2, "Finder") };
+    inventory.refresh();
+    provider->records = { window(20, 2, "Finder") };
+    const auto changes = inventory.refresh();
+
+    EXPECT_TRUE(changes.added.empty());
+    EXPECT_TRUE(changes.changed.empty());
+    EXPECT_EQ(changes.removed, std::vector<pid_t>({ 10 }));
+    EXPECT_TRUE(changes.affects(10));
+    EXPECT_FALSE(changes.affects(20));
+    EXPECT_FALSE(inventory.find(10));
+    EXPECT_EQ(inventory.windowIds(), QSet<quint64>({ 2 }));
+}
+
+TEST_F(WindowInventoryTest, TitleAndWindowChangesAreReported)
+{
+    provider->records = { window(10, 1, "Terminal"), window(20, 2, "Finder") };
+    inventory.refresh();
+    provider->records = { window(10, 1, "Terminal - vim"), window(20, 5, "Finder") };
+    const auto changes = inventory.refresh();
+
+    EXPECT_TRUE(changes.added.empty());
+    EXPECT_TRUE(changes.removed.empty());
+    auto changed = changes.changed;
+    std::sort(changed.begin(), changed.end());
+    EXPECT_EQ(changed, std::vector<pid_t>({ 10, 20 }));
+    EXPECT_EQ(inventory.find(10)->title, QStringLiteral("Terminal - vim"));
+    EXPECT_EQ(inventory.find(20)->windowId, 5u);
+    // icons are kept from the first sighting
+    EXPECT_EQ(provider->iconLookups, 2u);
+}
+
+TEST_F(WindowInventoryTest, UnchangedSnapshotsReportNothing)
+{
+    provider->records = { window(10, 1, "Terminal"), window(20, 2, "Finder") };
+    inventory.refresh();
+    const auto changes = inventory.refresh();
+
+    EXPECT_TRUE(changes.added.empty());
+    EXPECT_TRUE(changes.changed.empty());
+    EXPECT_TRUE(changes.removed.empty());
+    EXPECT_FALSE(changes.affects(10));
+    EXPECT_EQ(inventory.size(), 2u);
+    EXPECT_EQ(provider->enumerations, 2u);
+    EXPECT_EQ(provider->iconLookups, 2u);
+}
+
+int main(int argc, char** argv)
+{
+    // QPixmap wants an application, no display needed for null pixmaps
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}